@@ -328,11 +328,10 @@ public:
 
 int main() {
   int n = 8;
-  Board board;
+  Board board(n * n);
   for (int i = 0; i < n * n; i++) {
-    board.push_back(EMPTY);
     if (rand() % 1000 < 124)
-      board.back() = 1;
+      board[i] = 1;
   }
 
   // board = Board(n*n, 0);
@@ -0,0 +1,58 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+
+// Which cells of a board of side at most 64 hold pegs: a word per row, with
+// bit j for column j. Gives the cells a jump in each direction is legal from
+// for a whole row at once, with a few shifts, so searches can enumerate
+// legal moves by iterating over bits instead of scanning cells.
+class Bitboard {
+public:
+  int n;
+  vector<uint64_t> rows;
+  uint64_t full;  // the n columns
+  // Columns of even (odd) parity.
+  uint64_t even_columns;
+  uint64_t odd_columns;
+
+  explicit Bitboard(const Board &board) : n(board_size(board)), rows(n) {
+    assert(n <= 64);
+    full = n == 64 ? ~ZERO : (ONE << n) - 1;
+    even_columns = full & 0x5555555555555555ULL;
+    odd_columns = full & 0xAAAAAAAAAAAAAAAAULL;
+    for (int pos = 0; pos < n * n; pos++)
+      if (board[pos] != EMPTY)
+        set(pos);
+  }
+
+  bool get(int pos) const {
+    return rows[pos / n] >> (pos % n) & 1;
+  }
+
+  void set(int pos) {
+    rows[pos / n] |= ONE << (pos % n);
+  }
+
+  void clear(int pos) {
+    rows[pos / n] &= ~(ONE << (pos % n));
+  }
+
+  // Cells of row i a peg can jump from in direction dir: over a peg, onto
+  // an empty cell on the board.
+  uint64_t jumps(int i, int dir) const {
+    uint64_t occupied = rows[i];
+    switch (dir) {
+      case DIR_RIGHT:
+        return occupied & occupied >> 1 & ~(occupied >> 2) & full >> 2;
+      case DIR_LEFT:
+        return occupied & occupied << 1 & ~(occupied << 2) & (full & ~(uint64_t)3);
+      case DIR_UP:
+        return i < 2 ? 0 : occupied & rows[i - 1] & ~rows[i - 2];
+      default:
+        return i >= n - 2 ? 0 : occupied & rows[i + 1] & ~rows[i + 2];
+    }
+  }
+};
+
+
+#endif
@@ -5,12 +5,11 @@
 
 int main() {
   int n = 60;
-  Board board;
+  Board board(n * n);
   for (int i = 0; i < n * n; i++) {
-    board.push_back(EMPTY);
     int p = (i % n + i / n) % 2 == 1 ? 750 : 150;
     if (rand() % 1000 < p)
-      board.back() = 1;
+      board[i] = 1;
   }
 
   cout << board_to_string(board) << endl;
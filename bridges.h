@@ -7,7 +7,12 @@ typedef pair<int, int> Edge;
 
 vector<Edge> collect_edges(int n, const Board &board, int pos) {
   vector<Edge> result;
-  for (int delta : get_deltas(n, pos)) {
+  int dirs = board.jump_dirs(pos);
+  // In the order of get_deltas.
+  for (int dir : {DIR_UP, DIR_LEFT, DIR_RIGHT, DIR_DOWN}) {
+    if (!(dirs >> dir & 1))
+      continue;
+    int delta = board.delta(dir);
     if (board[pos + delta] != EMPTY && board[pos + 2 * delta] == EMPTY)
       result.emplace_back(pos, pos + 2 * delta);
   }
@@ -101,6 +106,64 @@ uint64_t compute_graph_hash(const Graph &g) {
   return result;
 }
 
+// Cheap upper bound on path score per connected component: a path can't use
+// more edges than its component has, and can't collect more than all their
+// middles.
+class ComponentBounds {
+public:
+  unordered_map<int, int> component;
+  vector<int> edge_counts;
+  vector<int> middle_sums;
+
+  ComponentBounds(const Graph &g, const Board &board) {
+    for (const auto &kv : g) {
+      if (component.count(kv.first) > 0)
+        continue;
+      int c = edge_counts.size();
+      edge_counts.push_back(0);
+      middle_sums.push_back(0);
+
+      vector<int> work = {kv.first};
+      component[kv.first] = c;
+      while (!work.empty()) {
+        int v = work.back();
+        work.pop_back();
+        for (int w : g.at(v)) {
+          if (v < w) {
+            edge_counts[c]++;
+            middle_sums[c] += board[(v + w) / 2];
+          }
+          if (component.count(w) == 0) {
+            component[w] = c;
+            work.push_back(w);
+          }
+        }
+      }
+    }
+  }
+
+  // For a path that starts with one of the given edges.
+  long long start_bound(const Board &board, const vector<Edge> &start_edges) const {
+    long long edges = 0;
+    long long middles = 0;
+    vector<int> seen;
+    for (const auto &e : start_edges) {
+      edges++;
+      middles += board[(e.first + e.second) / 2];
+      auto p = component.find(e.second);
+      if (p == component.end())
+        continue;
+      if (find(seen.begin(), seen.end(), p->second) != seen.end())
+        continue;
+      seen.push_back(p->second);
+      edges += edge_counts[p->second];
+      middles += middle_sums[p->second];
+    }
+    return edges * middles;
+  }
+};
+
+
 // http://stackoverflow.com/questions/11218746/bridges-in-a-connected-graph
 // with some added code to build bridge blocks
 class BridgeForest {
@@ -121,8 +184,8 @@ public:
   map<int, int> block_by_vertex;
 
 
-  BridgeForest(const Graph &g, int start = SENTINEL) : g(g) {
-    TimeIt t("bridge_forest");
+  BridgeForest(SolverContext &ctx, const Graph &g, int start = SENTINEL) : g(g) {
+    TimeIt t(ctx, "bridge_forest");
     for (const auto &kv : g) {
       int v = kv.first;
       assert(v != SENTINEL);  // it is used as special value below
@@ -131,7 +194,7 @@ public:
     cnt = 0;
 
     if (start == SENTINEL) {
-      TimeIt t("bridge_forest_sentinel");
+      TimeIt t(ctx, "bridge_forest_sentinel");
       for (const auto &kv : g) {
         int v = kv.first;
         if (pre[v] == -1) {
@@ -157,7 +220,7 @@ public:
       // It's possible that start is not in the graph.
       pre[start] = -1;
       low[start] = -1;
-      { TimeIt t("bridge_forest_dfs");
+      { TimeIt t(ctx, "bridge_forest_dfs");
       dfs(SENTINEL, start);
       }
 
@@ -171,7 +234,7 @@ public:
       parent_block.emplace_back(SENTINEL);
       children.emplace_back();
 
-      { TimeIt t("bridge_forest_dfs2");
+      { TimeIt t(ctx, "bridge_forest_dfs2");
       dfs2(SENTINEL, v, roots.back());
       }
     }
@@ -258,8 +321,8 @@ public:
   map<int, int> distance;
   int start;
 
-  ShortestPaths(const Graph &g, int start) : start(start) {
-    TimeIt t("shortest_paths");
+  ShortestPaths(SolverContext &ctx, const Graph &g, int start) : start(start) {
+    TimeIt t(ctx, "shortest_paths");
     for (const auto &kv : g) {
       assert(kv.first != SENTINEL);
     }
@@ -467,6 +530,7 @@ typedef vector<pair<int, int>> Frontier;
 
 class Expander {
 public:
+  SolverContext &ctx;
   vector<int> &path;
   Graph &extra;
   function<int(int, int)> color_func;
@@ -482,14 +546,15 @@ public:
   int best_ancestor;
   pair<int, int> best_left, best_right;
 
-  Expander(vector<int> &path, Graph &extra, function<int(int, int)> color_func)
-      : path(path), extra(extra), color_func(color_func) {
+  Expander(SolverContext &ctx, vector<int> &path, Graph &extra,
+           function<int(int, int)> color_func)
+      : ctx(ctx), path(path), extra(extra), color_func(color_func) {
     refresh();
   }
 
   // Has to be called when referenced path or extra were changed externally.
   void refresh() {
-    TimeIt t("expander_refresh");
+    TimeIt t(ctx, "expander_refresh");
 
     inc_score_in_path.clear();
     index_by_inc_score.clear();
@@ -523,7 +588,7 @@ public:
     work.push(root);
 
     while (!work.empty()) {
-      add_work(1e-6);
+      ctx.add_work(EXPANDER_BFS_STEP);
       int v = work.front();
       work.pop();
       for (int w : extra.at(v)) {
@@ -636,7 +701,7 @@ public:
       }
     }
 
-    add_work(1e-7 * f.size());
+    ctx.add_work(EXPANDER_FRONTIER_ITEM, f.size());
     frontiers[v] = f;
   }
 
@@ -666,8 +731,8 @@ public:
 };
 
 
-bool expand_cycle(int start_index, vector<int> &path, Graph &extra) {
-  TimeIt t("expand_cycle");
+bool expand_cycle(SolverContext &ctx, int start_index, vector<int> &path, Graph &extra) {
+  TimeIt t(ctx, "expand_cycle");
   int start = path[start_index];
   if(extra.count(start) == 0 or extra.at(start).size() < 2) {
     return false;
@@ -689,7 +754,7 @@ bool expand_cycle(int start_index, vector<int> &path, Graph &extra) {
     work.push(next);
 
     while (!work.empty()) {
-      add_work(1e-7);
+      ctx.add_work(CYCLE_STEP);
       int v = work.front();
       work.pop();
 
@@ -725,32 +790,170 @@ bool expand_cycle(int start_index, vector<int> &path, Graph &extra) {
 }
 
 
-map<tuple<int, int, int, int>, int> longest_path_stats;
+// Decomposes edges of extra reachable from the path into cycles and a forest
+// in one DFS walk, then splices all cycles connected to the path into it at
+// once. The path keeps its endpoints and absorbed edges are removed from extra.
+// Same outcome as calling expand_cycle on every index until nothing changes:
+// no cycle of extra passes through a path vertex afterwards.
+bool absorb_cycles(SolverContext &ctx, vector<int> &path, Graph &extra) {
+  TimeIt t(ctx, "absorb_cycles");
+  vector<vector<int>> cycles;
+  vector<Edge> forest_edges;
+
+  unordered_map<int, int> stack_index;
+  vector<int> stack;
+  for (int s : path) {
+    auto p = extra.find(s);
+    if (p == extra.end() || p->second.empty())
+      continue;
+    assert(stack.empty());
+    stack.push_back(s);
+    stack_index[s] = 0;
+    while (!stack.empty()) {
+      ctx.add_work(CYCLE_STEP);
+      int v = stack.back();
+      auto &adj = extra.at(v);
+      if (adj.empty()) {
+        stack.pop_back();
+        stack_index.erase(v);
+        if (!stack.empty())
+          forest_edges.emplace_back(stack.back(), v);
+        continue;
+      }
+      int w = adj.back();
+      remove_edge(extra, {v, w});
+      auto q = stack_index.find(w);
+      if (q == stack_index.end()) {
+        stack_index[w] = stack.size();
+        stack.push_back(w);
+      } else {
+        cycles.emplace_back(stack.begin() + q->second, stack.end());
+        cycles.back().push_back(w);
+        while (stack.back() != w) {
+          stack_index.erase(stack.back());
+          stack.pop_back();
+        }
+      }
+    }
+  }
+  for (const auto &e : forest_edges)
+    add_edge(extra, e);
 
-vector<int> longest_path_by_expansion(const Graph &g, int from, int to, const Board &board) {
-  TimeIt t("longest_path_by_expansion");
-  auto path = ShortestPaths(g, from).get_path(to);
+  if (cycles.empty())
+    return false;
 
+  // Cycles are attached to the path directly or through other cycles.
+  unordered_map<int, int> uf;
+  function<int(int)> find_root = [&uf, &find_root](int v) {
+    auto p = uf.find(v);
+    if (p == uf.end() || p->second == v)
+      return v;
+    return p->second = find_root(p->second);
+  };
+  auto unite = [&uf, &find_root](int a, int b) {
+    a = find_root(a);
+    b = find_root(b);
+    if (a != b)
+      uf[a] = b;
+  };
+  for (int v : path)
+    unite(v, path.front());
+  for (const auto &cycle : cycles)
+    for (int v : cycle)
+      unite(v, cycle.front());
 
-  Graph extra(g);
-  assert(!path.empty());
+  Graph g;
   for (int i = 1; i < path.size(); i++)
-    remove_edge(extra, {path[i - 1], path[i]});
+    add_edge(g, {path[i - 1], path[i]});
+  bool absorbed = false;
+  bool has_detached = false;
+  for (const auto &cycle : cycles) {
+    bool attached = find_root(cycle.front()) == find_root(path.front());
+    for (int i = 1; i < cycle.size(); i++) {
+      if (attached)
+        add_edge(g, {cycle[i - 1], cycle[i]});
+      else
+        add_edge(extra, {cycle[i - 1], cycle[i]});
+    }
+    absorbed = absorbed || attached;
+    has_detached = has_detached || !attached;
+  }
+  if (absorbed) {
+    if (path.size() == 1) {
+      // Closed trail, euler_path needs an edge to cut.
+      int v = path.front();
+      int w = g.at(v).back();
+      remove_edge(g, {v, w});
+      path = euler_path(g, w, v);
+      path.insert(path.begin(), v);
+    } else {
+      path = euler_path(g, path.front(), path.back());
+    }
+  }
+
+  if (has_detached) {
+    // Detached cycle can still close a cycle through the path together with
+    // forest edges. It's rare, so just check these components one by one.
+    unordered_map<int, bool> suspicious;
+    for (const auto &cycle : cycles) {
+      if (find_root(cycle.front()) == find_root(path.front()) ||
+          suspicious.count(cycle.front()) > 0)
+        continue;
+      vector<int> work = {cycle.front()};
+      suspicious[cycle.front()] = true;
+      while (!work.empty()) {
+        int v = work.back();
+        work.pop_back();
+        for (int w : extra.at(v))
+          if (suspicious.count(w) == 0) {
+            suspicious[w] = true;
+            work.push_back(w);
+          }
+      }
+    }
+    for (int i = 0; i < path.size(); i++) {
+      if (suspicious.count(path[i]) > 0 && expand_cycle(ctx, i, path, extra))
+        absorbed = true;
+    }
+  }
+
+  return absorbed;
+}
 
-  // TODO: support randomized changes even if new slice has the same length
-  // as the old one.
 
-  Expander expander(path, extra, [&board](int a, int b) {
+function<int(int, int)> edge_score_func(const Board &board) {
+  return [&board](int a, int b) {
     assert(a != b);
     assert((a + b) % 2 == 0);
     assert(board[(a + b) / 2] != EMPTY);
     return 100 + board[(a + b) / 2];
-  });
+  };
+}
+
+
+// Improves path in place until local optimum or deadline.
+// Extra must contain exactly the edges of g not used by path, and expander
+// must be bound to path and extra.
+// Returns the number of rounds it took.
+int expand_trail(
+    SolverContext &ctx, const Graph &g, vector<int> &path, Graph &extra,
+    Expander &expander) {
+  TimeIt t(ctx, "longest_path_by_expansion");
+  #ifndef NDEBUG
+  // For the asserts that expansion keeps the endpoints.
+  int from = path.front();
+  int to = path.back();
+  #endif
+
+  // TODO: support randomized changes even if new slice has the same length
+  // as the old one.
 
   bool deadline_exceeded = false;
+  int rounds = 0;
 
   int seed = 42;
   while (true) {
+    rounds++;
     vector<int> roots;
     for (const auto &kv : extra) {
       if (!kv.second.empty()) {
@@ -763,7 +966,7 @@ vector<int> longest_path_by_expansion(const Graph &g, int from, int to, const Bo
     for (int root : roots) {
 
       // It makes sense for very short paths.
-      if (expand_cycle(rand() % path.size(), path, extra)) {
+      if (expand_cycle(ctx, ctx.rand() % path.size(), path, extra)) {
         assert(is_path_in_graph(g, from, to, path));
         expander.refresh();
         had_improvement = true;
@@ -773,21 +976,15 @@ vector<int> longest_path_by_expansion(const Graph &g, int from, int to, const Bo
         assert(is_path_in_graph(g, from, to, path));
         had_improvement = true;
       }
-      if (check_deadline()) {
+      if (ctx.check_deadline()) {
         deadline_exceeded = true;
         break;
       }
     }
-    bool need_refresh = false;
-    for (int i = 0; i < path.size(); i++) {
-      if (expand_cycle(i, path, extra)) {
-        assert(is_path_in_graph(g, from, to, path));
-        need_refresh = true;
-        had_improvement = true;
-      }
-    }
-    if (need_refresh) {
+    if (absorb_cycles(ctx, path, extra)) {
+      assert(is_path_in_graph(g, from, to, path));
       expander.refresh();
+      had_improvement = true;
     }
     if (!had_improvement)  {
       break;
@@ -803,10 +1000,25 @@ vector<int> longest_path_by_expansion(const Graph &g, int from, int to, const Bo
     }
     assert(degrees[0] == 0);
     assert(degrees[1] == 0);
-    longest_path_stats[make_tuple(degrees[2], degrees[3], degrees[4], path.size() - 1)]++;
+    ctx.longest_path_stats[make_tuple(degrees[2], degrees[3], degrees[4], path.size() - 1)]++;
   }
 
   assert(is_path_in_graph(g, from, to, path));
+  return rounds;
+}
+
+
+vector<int> longest_path_by_expansion(
+    SolverContext &ctx, const Graph &g, int from, int to, const Board &board) {
+  auto path = ShortestPaths(ctx, g, from).get_path(to);
+
+  Graph extra(g);
+  assert(!path.empty());
+  for (int i = 1; i < path.size(); i++)
+    remove_edge(extra, {path[i - 1], path[i]});
+
+  Expander expander(ctx, path, extra, edge_score_func(board));
+  expand_trail(ctx, g, path, extra, expander);
   return path;
 }
 
@@ -823,62 +1035,153 @@ int upper_bound_on_longest_path_in_2_edge_connected(const Graph &g, int from, in
 
 #define LP_CACHE
 
-#ifdef LP_CACHE
-typedef tuple<int, int, uint64_t> CacheKey;
-map<CacheKey, vector<int>> cache;
-#endif
-
 
 //vector<int> longest_path(const Graph &g, int from, int to);
 
 
-vector<int> longest_path_in_2_edge_connected(const Graph &g, int from, int to, const Board &board) {
-  //cout << "lpi2ec " << g << " " << from << " " << to << endl;
+// Longest trails from one source to each of the targets (result is parallel
+// to targets). Shares the BFS, the expander and the extra graph between
+// targets, and seeds each search with the longest prefix of an already found
+// trail that ends in the target.
+vector<vector<int>> longest_paths_in_2_edge_connected(
+    SolverContext &ctx, const Graph &g, int from, const vector<int> &targets, const Board &board) {
+  vector<vector<int>> result(targets.size());
   if (g.empty()) {
-    if (from == to)
-      return {to};
-    else
-      return {};
+    for (int k = 0; k < targets.size(); k++)
+      if (targets[k] == from)
+        result[k] = {from};
+    return result;
   }
 
   //assert(BridgeForest(g).roots.size() == 1);
 
   assert(g.count(from) == 1);
-  assert(g.count(to) == 1);
-
-  vector<int> odd = odd_vertices(g, from, to);
-  assert(odd.size() % 2 == 0);
-
-  if (odd.empty()) {
-    auto result = euler_path(g, from, to);
-    assert(!result.empty());
-    return result;
-  }
 
   #ifdef LP_CACHE
-  // TODO: Symmetry exploitation it does not seem to help. Investigate.
-  // if (to < from) {
-  //   auto result = longest_path_in_2_edge_connected(g, to, from);
-  //   reverse(result.begin(), result.end());
-  //   return result;
-  // }
-
-  CacheKey cache_key(from, to, compute_graph_hash(g));
-  if (cache.count(cache_key) > 0) {
-    if (is_path_in_graph(g, from, to, cache[cache_key]))
-      return cache[cache_key];
-    else
-      cerr << "collision" << endl;
-  }
+  uint64_t graph_hash = compute_graph_hash(g);
   #endif
 
-  auto result = longest_path_by_expansion(g, from, to, board);
+  // Shared state is only set up when some target actually needs expansion.
+  unique_ptr<ShortestPaths> sp;
+  vector<int> path = {from};
+  Graph extra;
+  Expander expander(ctx, path, extra, edge_score_func(board));
 
-  #ifdef LP_CACHE
-  return cache[cache_key] = result;
-  #else
+  for (int k = 0; k < targets.size(); k++) {
+    int to = targets[k];
+    assert(g.count(to) == 1);
+
+    auto dup = find(targets.begin(), targets.begin() + k, to);
+    if (dup != targets.begin() + k) {
+      result[k] = result[dup - targets.begin()];
+      continue;
+    }
+
+    #ifdef LP_TELEMETRY
+    double start_time = get_time();
+    const char *source = "miss";
+    int rounds = 0;
+    #endif
+
+    vector<int> odd = odd_vertices(g, from, to);
+    assert(odd.size() % 2 == 0);
+
+    bool done = false;
+    if (odd.empty()) {
+      result[k] = euler_path(g, from, to);
+      assert(!result[k].empty());
+      #ifdef LP_TELEMETRY
+      source = "euler";
+      #endif
+      done = true;
+    }
+
+    #ifdef LP_CACHE
+    // TODO: Symmetry exploitation it does not seem to help. Investigate.
+    // if (to < from) {
+    //   auto result = longest_path_in_2_edge_connected(g, to, from);
+    //   reverse(result.begin(), result.end());
+    //   return result;
+    // }
+
+    CacheKey cache_key(from, to, graph_hash);
+    if (!done && ctx.shared_lp_cache && ctx.lp_cache.count(cache_key) == 0) {
+      vector<int> cached;
+      if (ctx.shared_lp_cache->find(cache_key, cached)) {
+        ctx.lp_cache[cache_key] = cached;
+        ctx.shared_lp_cache_hits++;
+      }
+    }
+    if (!done && ctx.lp_cache.count(cache_key) > 0) {
+      if (is_path_in_graph(g, from, to, ctx.lp_cache[cache_key])) {
+        result[k] = ctx.lp_cache[cache_key];
+        #ifdef LP_TELEMETRY
+        source = "hit";
+        #endif
+        done = true;
+      }
+      else
+        LOG(LOG_INFO) << "collision";
+    }
+    #endif
+
+    if (!done) {
+      if (!sp) {
+        sp.reset(new ShortestPaths(ctx, g, from));
+        extra = g;
+      }
+
+      vector<int> seed = sp->get_path(to);
+      assert(!seed.empty());
+      for (int j = 0; j < k; j++) {
+        const auto &r = result[j];
+        for (int q = (int)r.size() - 1; q >= (int)seed.size(); q--) {
+          if (r[q] == to) {
+            seed.assign(r.begin(), r.begin() + q + 1);
+            break;
+          }
+        }
+      }
+
+      for (int i = 1; i < path.size(); i++)
+        add_edge(extra, {path[i - 1], path[i]});
+      for (int i = 1; i < seed.size(); i++)
+        remove_edge(extra, {seed[i - 1], seed[i]});
+      path = seed;
+      expander.refresh();
+
+      #ifdef LP_TELEMETRY
+      rounds = expand_trail(ctx, g, path, extra, expander);
+      #else
+      expand_trail(ctx, g, path, extra, expander);
+      #endif
+      result[k] = path;
+
+      #ifdef LP_CACHE
+      ctx.lp_cache[cache_key] = result[k];
+      #endif
+    }
+
+    #ifdef LP_TELEMETRY
+    BlockRecord record;
+    record.edges = num_edges(g);
+    record.odd = odd.size();
+    record.upper_bound = record.edges - record.odd / 2;
+    record.length = result[k].size() - 1;
+    record.rounds = rounds;
+    record.time = get_time() - start_time;
+    record.source = source;
+    ctx.lp_telemetry.add(record);
+    #endif
+  }
   return result;
-  #endif
+}
+
+
+vector<int> longest_path_in_2_edge_connected(
+    SolverContext &ctx, const Graph &g, int from, int to, const Board &board) {
+  //cout << "lpi2ec " << g << " " << from << " " << to << endl;
+  return longest_paths_in_2_edge_connected(ctx, g, from, {to}, board).front();
 
   /*
 
@@ -959,7 +1262,8 @@ vector<int> longest_path_in_2_edge_connected(const Graph &g, int from, int to, c
 }
 
 
-vector<int> longest_path_in_bridge_forest(const BridgeForest &bf, int from, int to, const Board &board) {
+vector<int> longest_path_in_bridge_forest(
+    SolverContext &ctx, const BridgeForest &bf, int from, int to, const Board &board) {
   //assert(bf.block_by_vertex.count(from) > 0);
   if (bf.block_by_vertex.count(to) == 0)
     return {};
@@ -978,14 +1282,14 @@ vector<int> longest_path_in_bridge_forest(const BridgeForest &bf, int from, int
     assert(bf.parent_block[i] != SENTINEL);
     assert(bf.block_by_vertex.at(e.first) == bf.parent_block[i]);
 
-    auto hz = longest_path_in_2_edge_connected(bf.bridge_blocks[i], e.second, v, board);
+    auto hz = longest_path_in_2_edge_connected(ctx, bf.bridge_blocks[i], e.second, v, board);
     assert(!hz.empty());
     fragments.push_back(hz);
     fragments.push_back({e.first, e.second});
     v = e.first;
   }
 
-  auto hz = longest_path_in_2_edge_connected(bf.bridge_blocks[start_block], from, v, board);
+  auto hz = longest_path_in_2_edge_connected(ctx, bf.bridge_blocks[start_block], from, v, board);
   assert(!hz.empty());
   fragments.push_back(hz);
 
@@ -997,9 +1301,10 @@ vector<int> longest_path_in_bridge_forest(const BridgeForest &bf, int from, int
 }
 
 
-vector<int> longest_path(const Graph &g, int from, int to, const Board &board) {
-  BridgeForest bf(g, from);
-  vector<int> result = longest_path_in_bridge_forest(bf, from, to, board);
+vector<int> longest_path(
+    SolverContext &ctx, const Graph &g, int from, int to, const Board &board) {
+  BridgeForest bf(ctx, g, from);
+  vector<int> result = longest_path_in_bridge_forest(ctx, bf, from, to, board);
   if (!result.empty()) {
     // cerr << g << endl;
     // cerr << from << " ... "<< to << endl;
@@ -1010,8 +1315,9 @@ vector<int> longest_path(const Graph &g, int from, int to, const Board &board) {
 }
 
 
-vector<int> longest_path_from(const Graph &g, int from, const Board &board) {
-  BridgeForest bf(g, from);
+vector<int> longest_path_from(
+    SolverContext &ctx, const Graph &g, int from, const Board &board) {
+  BridgeForest bf(ctx, g, from);
   assert(bf.roots == vector<int>{0});
   assert(bf.block_entry_point(0) == from);
 
@@ -1030,10 +1336,13 @@ vector<int> longest_path_from(const Graph &g, int from, const Board &board) {
       return best_path[c1].size() > best_path[c2].size();
     });
 
+    // All endpoints are solved in one go, see longest_paths_in_2_edge_connected.
+    vector<int> targets;
     for (int child : children) {
       assert(child > i);
       Edge e = bf.bridge_edges[child];
       tried_endpoints.insert(e.first);
+      targets.push_back(e.first);
 
       /*
       int ub = upper_bound_on_longest_path_in_2_edge_connected(block, bf.block_entry_point(i), e.first);
@@ -1042,9 +1351,25 @@ vector<int> longest_path_from(const Graph &g, int from, const Board &board) {
         // cerr << "by " << (best_path[i].size() - (ub + 1 + best_path[child].size())) << endl;
         continue;
       }*/
+    }
 
-      vector<int> path = longest_path_in_2_edge_connected(
-        block, bf.block_entry_point(i), e.first, board);
+    int limit = ctx.params.inner_endpoints;
+    // Try paths that end inside the block.
+    for (int v : odd_vertices(block, bf.block_entry_point(i))) {
+      if (tried_endpoints.count(v) == 0) {
+        if (limit-- == 0) break;
+        targets.push_back(v);
+      }
+    }
+
+    auto paths = longest_paths_in_2_edge_connected(
+        ctx, block, bf.block_entry_point(i), targets, board);
+
+    for (int k = 0; k < children.size(); k++) {
+      int child = children[k];
+      Edge e = bf.bridge_edges[child];
+
+      vector<int> path = paths[k];
       extend_path(path, {e.first, e.second});
       extend_path(path, best_path[child]);
 
@@ -1055,18 +1380,11 @@ vector<int> longest_path_from(const Graph &g, int from, const Board &board) {
       }
     }
 
-    int limit = 2;
-    // Try paths that end inside the block.
-    for (int v : odd_vertices(block, bf.block_entry_point(i))) {
-      if (tried_endpoints.count(v) == 0) {
-        if (--limit == 0) break;
-
-        vector<int> path = longest_path_in_2_edge_connected(
-            block, bf.block_entry_point(i), v, board);
-        if (path.size() > best_path[i].size()) {
-          assert(path.front() == best_path[i].front());
-          best_path[i] = path;
-        }
+    for (int k = children.size(); k < targets.size(); k++) {
+      const vector<int> &path = paths[k];
+      if (path.size() > best_path[i].size()) {
+        assert(path.front() == best_path[i].front());
+        best_path[i] = path;
       }
     }
   }
@@ -8,12 +8,11 @@
 
 int main() {
   int n = 40;
-  Board board;
+  Board board(n * n);
   for (int i = 0; i < n * n; i++) {
-    board.push_back(EMPTY);
     int p = (i % n + i / n) % 2 == 1 ? 750 : 150;
     if (rand() % 1000 < p)
-      board.back() = 1 + rand() % 9;
+      board[i] = 1 + rand() % 9;
   }
 
   cerr << board_to_string(board) << endl;
@@ -32,7 +31,8 @@ int main() {
     }
   }
 
-  BridgeForest bf(g, 4);
+  SolverContext ctx;
+  BridgeForest bf(ctx, g, 4);
   bf.show(cerr);
 
   Graph largest;
@@ -55,7 +55,7 @@ int main() {
 
   vector<int> path;
 
-  path = longest_path_by_expansion(largest, v, v + 0*n, board);
+  path = longest_path_by_expansion(ctx, largest, v, v + 0*n, board);
 
   cerr << path.size() << " " << path << endl;
   cerr << path_to_string(n, path) << endl;
@@ -73,7 +73,7 @@ int main() {
 
 
 
-  cerr << longest_path_stats << endl;
+  cerr << ctx.longest_path_stats << endl;
 
-  print_timers(cerr);
+  ctx.print_timers(cerr);
 }
@@ -1,13 +1,17 @@
 #define NDEBUG
 
 #include "common.h"
+#include "bitboard.h"
 
 
 
+// All jump paths of one peg on the board. Finds the legal jumps from the
+// pegs in a Bitboard, where the moving peg is kept too.
 class ChainEnumerator {
 public:
   int n;
   Board &board;
+  Bitboard occupied;
 
   vector<vector<int>> paths;
 
@@ -15,7 +19,7 @@ public:
   int sum;
 
   ChainEnumerator(int n, Board &board)
-    : n(n), board(board) {
+    : n(n), board(board), occupied(board) {
   }
 
   void find() {
@@ -43,18 +47,24 @@ public:
   void rec(int pos) {
     path.push_back(pos);
 
-    vector<int> deltas = get_deltas(n, pos);
-    bool has_moves = false;
-    for (int delta : deltas) {
-      if (board[pos + delta] == EMPTY) continue;
-      if (board[pos + 2*delta] != EMPTY) continue;
-      has_moves = true;
+    int i = pos / n;
+    int j = pos % n;
+    // In the order of get_deltas.
+    for (int dir : {DIR_UP, DIR_LEFT, DIR_RIGHT, DIR_DOWN}) {
+      if (!(occupied.jumps(i, dir) >> j & 1)) continue;
+      int delta = board.delta(dir);
       Cell backup = board[pos + delta];
       sum += backup;
       board[pos + delta] = EMPTY;
+      occupied.clear(pos);
+      occupied.clear(pos + delta);
+      occupied.set(pos + 2*delta);
 
       rec(pos + 2*delta);
 
+      occupied.clear(pos + 2*delta);
+      occupied.set(pos + delta);
+      occupied.set(pos);
       sum -= backup;
       board[pos + delta] = backup;
     }
@@ -68,7 +78,7 @@ public:
 };
 
 
-int sum(const vector<int> xs) {
+int sum(const vector<Cell> &xs) {
   int result = 0;
   for (int x : xs) result += x;
   return result;
@@ -76,35 +86,15 @@ int sum(const vector<int> xs) {
 
 
 vector<Cell> apply_path(Board &board, const vector<int> &path) {
-  vector<Cell> consumed;
-
   assert(path.size() >= 2);
-
-  Cell moving_peg = board[path.front()];
-  assert(moving_peg != EMPTY);
-  board[path.front()] = EMPTY;
-
-  int sum = 0;
-  for (int i = 1; i < path.size(); i++) {
-    assert(board[path[i]] == EMPTY);
-    int x = (path[i - 1] + path[i]) / 2;
-    assert(board[x] != EMPTY);
-    consumed.push_back(board[x]);
-    board[x] = EMPTY;
-  }
-
-  board[path.back()] = moving_peg;
+  vector<Cell> consumed;
+  apply_all(board, path_to_moves(path), consumed);
   return consumed;
 }
 
-void undo_path(Board &board, const vector<int> &path, const vector<Cell> &consumed) {
+void undo_path(Board &board, const vector<int> &path, vector<Cell> consumed) {
   assert(path.size() - 1 == consumed.size());
-  for (int i = 1; i < path.size(); i++) {
-    board[(path[i - 1] + path[i]) / 2] = consumed[i - 1];
-  }
-  Cell t = board[path.back()];
-  board[path.back()] = EMPTY;
-  board[path.front()] = t;
+  undo_all(board, path_to_moves(path), consumed);
 }
 
 
@@ -134,6 +124,7 @@ public:
   int cnt;
 
   vector<vector<int>> paths, best_paths;
+  vector<vector<Cell>> consumed;  // by paths
 
   Brute(int n, const Board &board) : n(n), board(board) {
     score = 0;
@@ -142,11 +133,18 @@ public:
   }
 
   void rec() {
-    cnt++;
-    if (cnt > 50000000) {
+    SearchEngine<Brute> engine(*this);
+    if (!engine.run(50000000)) {
       cout << "EXIT!" << endl;
-      return;
+      engine.abandon();
     }
+  }
+
+  // SearchEngine interface. Steps are whole paths.
+  typedef vector<int> Step;
+
+  bool visit() {
+    cnt++;
     //cerr << "rec" << paths << score << endl;
     if (paths.size() == 1) {
       cerr << paths << "..." << endl;
@@ -156,7 +154,10 @@ public:
       best_score = score;
       best_paths = paths;
     }
+    return true;
+  }
 
+  void expand(vector<vector<int>> &steps) {
     //Board backup = board;
     ChainEnumerator ce(n, board);
     ce.find();
@@ -169,51 +170,41 @@ public:
         if (paths.back() < path && paths_commute(paths.back(), path))
           continue;
       }
-
-      auto consumed = apply_path(board, path);
-      int path_score = (path.size() - 1) * sum(consumed);
-
-      paths.push_back(path);
-      score += path_score;
-
-      rec();
-
-      score -= path_score;
-      paths.pop_back();
-
-      undo_path(board, path, consumed);
-      // cout << path << endl;
-      // cout << board_to_string(board);
-      // cout << board_to_string(backup);
-      // cout << "-------" << endl;
-      //assert(board == backup);
-      //board = backup;
+      steps.push_back(path);
     }
   }
-};
 
+  void apply(const vector<int> &path) {
+    consumed.push_back(apply_path(board, path));
+    int path_score = (path.size() - 1) * sum(consumed.back());
 
-vector<Move> path_to_moves(const vector<int> &path) {
-  assert(path.size() >= 2);
-  vector<Move> result;
-  for (int i = 1; i < path.size(); i++) {
-    int start = path[i - 1];
-    int delta = path[i] - start;
-    assert(delta % 2 == 0);
-    delta /= 2;
-    result.emplace_back(start, delta);
+    paths.push_back(path);
+    score += path_score;
   }
-  return result;
-}
+
+  void undo(const vector<int> &path) {
+    int path_score = (path.size() - 1) * sum(consumed.back());
+    score -= path_score;
+    paths.pop_back();
+
+    undo_path(board, path, consumed.back());
+    consumed.pop_back();
+    // cout << path << endl;
+    // cout << board_to_string(board);
+    // cout << board_to_string(backup);
+    // cout << "-------" << endl;
+    //assert(board == backup);
+    //board = backup;
+  }
+};
 
 
 int main() {
   int n = 10;
-  Board board;
+  Board board(n * n);
   for (int i = 0; i < n * n; i++) {
-    board.push_back(EMPTY);
     if (rand() % 1000 < 400)
-      board.back() = rand() % 9 + 1;
+      board[i] = rand() % 9 + 1;
   }
 
   // for (int i = 4; i < 6; i++)
@@ -0,0 +1,129 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+// Time and score gain of solver stages, measured round by round.
+// Preparation stages (sparsify, patch optimization) don't score by
+// themselves, so their gain is the change of a potential: an estimate of what
+// the long path stage can get out of the board. This way all rates are in
+// score per second and can be compared.
+class StageBudget {
+public:
+  map<string, double> times;
+  map<string, double> gains;
+  map<string, int> rounds;
+  map<string, double> last_rates;
+
+  void add_round(const string &stage, double time, double gain) {
+    times[stage] += time;
+    gains[stage] += gain;
+    rounds[stage]++;
+    last_rates[stage] = gain / max(time, 1e-6);
+  }
+
+  // Another round of a preparation stage is worth it if its last round
+  // gained faster than the final stage would turn the potential into score
+  // given all the remaining time. First min_rounds are always worth it,
+  // because the potential is too crude to judge them on small boards.
+  bool worth_another_round(
+      const string &stage, double potential, double remaining,
+      int min_rounds = 1) const {
+    auto p = rounds.find(stage);
+    if (p == rounds.end() || p->second < min_rounds)
+      return true;
+    if (remaining <= 0)
+      return false;
+    return last_rates.at(stage) > potential / remaining;
+  }
+
+  void print(ostream &out) const {
+    for (const auto &kv : rounds) {
+      const string &stage = kv.first;
+      out << "# " << stage << "_stage_rounds = " << kv.second << endl;
+      out << "# " << stage << "_stage_time = " << times.at(stage) << endl;
+      out << "# " << stage << "_stage_gain = " << gains.at(stage) << endl;
+      out << "# " << stage << "_stage_rate = "
+          << gains.at(stage) / max(times.at(stage), 1e-6) << endl;
+    }
+  }
+};
+
+
+// Named time budgets in seconds. "full" is what the contest allows, and the
+// stage limits below were tuned for it.
+const vector<pair<string, double>> BUDGET_TIERS = {
+  {"interactive", 0.1},
+  {"fast", 1.0},
+  {"full", 9.0},
+};
+const double FULL_BUDGET = 9.0;
+
+
+// Accepts a tier name or a number of seconds.
+bool parse_budget(const string &s, double &seconds) {
+  for (const auto &tier : BUDGET_TIERS)
+    if (tier.first == s) {
+      seconds = tier.second;
+      return true;
+    }
+  char *end;
+  double value = strtod(s.c_str(), &end);
+  if (end == s.c_str() || *end != 0 || !(value > 0))
+    return false;
+  seconds = value;
+  return true;
+}
+
+
+// Stage limits of one solve, all derived from its time budget alone. On a
+// slow or busy host the deadline cuts the stages short instead.
+// Iteration limits shrink in proportion to the budget, down to floors below
+// which the searches stop finding anything. Under half a second, patch
+// optimization is dropped and sparsification runs once, because the long path
+// stage makes much better use of the time.
+struct SolveLimits {
+  double time_limit;
+  int min_sparsify_rounds;
+  int max_sparsify_rounds;
+  int min_patch_rounds;
+  int max_patch_rounds;
+  int patch_iterations;  // PatchOptimizer per tile
+  int block_iterations;  // SimpleOptimizer per block of BlobPreprocessor
+  int blob_tries;  // block layouts tried by BlobPreprocessor::optimize
+
+  // wait() returns by then, whether the solve is over or not.
+  double latency_cap() const {
+    return time_limit + min(0.5, 0.5 * time_limit);
+  }
+
+  void print(ostream &out) const {
+    out << "# time_limit = " << time_limit << endl;
+    out << "# max_sparsify_rounds = " << max_sparsify_rounds << endl;
+    out << "# max_patch_rounds = " << max_patch_rounds << endl;
+    out << "# patch_iterations = " << patch_iterations << endl;
+    out << "# block_iterations = " << block_iterations << endl;
+    out << "# blob_tries = " << blob_tries << endl;
+  }
+};
+
+
+SolveLimits limits_for_budget(double seconds) {
+  double scale = min(1.0, seconds / FULL_BUDGET);
+  SolveLimits limits;
+  limits.time_limit = seconds;
+  limits.patch_iterations = max(20000, int(500000 * scale));
+  limits.block_iterations = max(1000, int(10000 * scale));
+  limits.blob_tries = max(2, int(20 * scale + 0.5));
+  if (seconds < 0.5) {
+    limits.min_sparsify_rounds = limits.max_sparsify_rounds = 1;
+    limits.min_patch_rounds = limits.max_patch_rounds = 0;
+  } else {
+    limits.min_sparsify_rounds = 2;
+    limits.max_sparsify_rounds = 4;
+    limits.min_patch_rounds = 2;
+    limits.max_patch_rounds = 8;
+  }
+  return limits;
+}
+
+
+#endif
@@ -14,17 +14,141 @@
 #include <queue>
 #include <unordered_map>
 #include <functional>
+#include <memory>
+#include <random>
+#include <mutex>
+#include <atomic>
+#include <cmath>
+#include <stdint.h>
 
 #include "pretty_printing.h"
+#include "logging.h"
+#include "validator.h"
 #include "bit_powersets.h"
 #include "timers.h"
+#include "context.h"
+#include "search.h"
 
 using namespace std;
 
 
-typedef int Cell;
+// A peg value, or EMPTY.
+typedef uint8_t Cell;
 const Cell EMPTY = 0;
-typedef vector<Cell> Board;
+const int MAX_PEG_VALUE = 255;
+
+
+// What only depends on the side of a board, by cell: the directions a jump
+// can take from it without leaving the board, and its parity class
+// (row % 2 * 2 + column % 2). Made once per side and shared by all boards.
+class BoardGeometry {
+public:
+  int n;
+  vector<uint8_t> jump_dirs;  // bit d is set if Direction d stays on board
+  vector<uint8_t> parity_class;
+  int deltas[4];  // by Direction
+
+  explicit BoardGeometry(int n)
+      : n(n), jump_dirs(n * n), parity_class(n * n) {
+    deltas[DIR_UP] = -n;
+    deltas[DIR_RIGHT] = 1;
+    deltas[DIR_DOWN] = n;
+    deltas[DIR_LEFT] = -1;
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++) {
+        int pos = i * n + j;
+        jump_dirs[pos] = (i >= 2) << DIR_UP | (j < n - 2) << DIR_RIGHT |
+                         (i < n - 2) << DIR_DOWN | (j >= 2) << DIR_LEFT;
+        parity_class[pos] = i % 2 * 2 + j % 2;
+      }
+  }
+
+  static shared_ptr<const BoardGeometry> of(int n) {
+    static mutex m;
+    static map<int, shared_ptr<const BoardGeometry>> cache;
+    lock_guard<mutex> lock(m);
+    auto &g = cache[n];
+    if (!g)
+      g = make_shared<const BoardGeometry>(n);
+    return g;
+  }
+};
+
+
+// n x n cells, row by row. Keeps its side and geometry, so that neither is
+// recomputed from the size. Only square sizes make a usable board.
+class Board {
+public:
+  typedef Cell value_type;
+  typedef vector<Cell>::iterator iterator;
+  typedef vector<Cell>::const_iterator const_iterator;
+
+  Board() { update_side(); }
+
+  explicit Board(size_t size, Cell value = EMPTY) : cells(size, value) {
+    update_side();
+  }
+
+  size_t size() const { return cells.size(); }
+  bool empty() const { return cells.empty(); }
+
+  Cell &operator[](size_t pos) { return cells[pos]; }
+  const Cell &operator[](size_t pos) const { return cells[pos]; }
+  Cell &at(size_t pos) { return cells.at(pos); }
+  const Cell &at(size_t pos) const { return cells.at(pos); }
+
+  iterator begin() { return cells.begin(); }
+  iterator end() { return cells.end(); }
+  const_iterator begin() const { return cells.begin(); }
+  const_iterator end() const { return cells.end(); }
+
+  void resize(size_t size) {
+    cells.resize(size);
+    update_side();
+  }
+
+  bool operator==(const Board &other) const { return cells == other.cells; }
+  bool operator!=(const Board &other) const { return cells != other.cells; }
+
+  int side() const {
+    assert(n >= 0);
+    return n;
+  }
+
+  // Bits of the Directions a jump from pos can take, see BoardGeometry.
+  int jump_dirs(int pos) const { return geometry->jump_dirs[pos]; }
+  int parity_class(int pos) const { return geometry->parity_class[pos]; }
+  int delta(int dir) const { return geometry->deltas[dir]; }
+
+private:
+  vector<Cell> cells;
+  int n;  // -1 if the size isn't square
+  shared_ptr<const BoardGeometry> geometry;
+
+  void update_side() {
+    n = (int)sqrt((double)cells.size());
+    while (n * n > cells.size())
+      n--;
+    while ((n + 1) * (n + 1) <= cells.size())
+      n++;
+    if (n * n == cells.size()) {
+      geometry = BoardGeometry::of(n);
+    } else {
+      n = -1;
+      geometry.reset();
+    }
+  }
+};
+
+
+// How Move::apply treats the board. UNCHECKED indexes it directly and only
+// asserts that the move is legal, for the solver's own moves. CHECKED makes
+// sure first and leaves the board alone if it isn't, for moves that come
+// from elsewhere.
+enum ApplyPolicy {
+  UNCHECKED,
+  CHECKED,
+};
 
 
 struct Move {
@@ -38,21 +162,58 @@ struct Move {
   Move(int start, int delta)
     : start(start), delta(delta), middle(EMPTY) {}
 
-  void apply(Board &board) const {
-    // board[start + 2 * delta] = board[start];
-    // board[start] = EMPTY;
-    // board[start + delta] = middle;
+  // Only returns false with CHECKED.
+  template<ApplyPolicy policy = UNCHECKED>
+  bool apply(Board &board) const {
+    if (policy == CHECKED && illegal_reason(board) != nullptr)
+      return false;
+
+    assert(board[start + 2 * delta] == EMPTY);
 
-    assert(board.at(start + 2 * delta) == EMPTY);
+    assert((board[start + delta] != EMPTY && middle == EMPTY) ||
+           (board[start + delta] == EMPTY && middle != EMPTY));
 
-    assert((board.at(start + delta) != EMPTY && middle == EMPTY) ||
-           (board.at(start + delta) == EMPTY && middle != EMPTY));
+    assert(board[start] != EMPTY);
 
-    assert(board.at(start) != EMPTY);
+    board[start + 2 * delta] = board[start];
+    board[start] = EMPTY;
+    board[start + delta] = middle;
+    return true;
+  }
+
+  // Also keeps what was in the middle in consumed, for undo.
+  void apply(Board &board, vector<Cell> &consumed) const {
+    consumed.push_back(board[start + delta]);
+    apply(board);
+  }
 
-    board.at(start + 2 * delta) = board.at(start);
-    board.at(start) = EMPTY;
-    board.at(start + delta) = middle;
+  // Reverts apply(board, consumed), if no later move is still applied.
+  void undo(Board &board, vector<Cell> &consumed) const {
+    board[start] = board[start + 2 * delta];
+    board[start + 2 * delta] = EMPTY;
+    board[start + delta] = consumed.back();
+    consumed.pop_back();
+  }
+
+  // Why the move leaves the board or breaks apply's asserts, or nullptr if
+  // it is legal.
+  const char *illegal_reason(const Board &board) const {
+    int n = board.side();
+    int dir = delta == -n ? DIR_UP : delta == 1 ? DIR_RIGHT :
+              delta == n ? DIR_DOWN : delta == -1 ? DIR_LEFT : -1;
+    if (start < 0 || start >= board.size())
+      return "start off the board";
+    if (dir < 0)
+      return "bad delta";
+    if (!(board.jump_dirs(start) >> dir & 1))
+      return "jump off the board";
+    if (board[start] == EMPTY)
+      return "no peg to move";
+    if (board[start + 2 * delta] != EMPTY)
+      return "target not empty";
+    if ((board[start + delta] == EMPTY) != (middle != EMPTY))
+      return middle == EMPTY ? "no peg to jump over" : "middle not empty";
+    return nullptr;
   }
 
   Move transpose(int n) const {
@@ -67,17 +228,87 @@ ostream& operator<<(ostream& out, Move move) {
   if (move.middle == EMPTY)
     out << "Move(" << move.start << ", " << move.delta << ")";
   else
-    out << "Move(" << move.start << ", " << move.delta << ", " << move.middle << ")";
+    out << "Move(" << move.start << ", " << move.delta << ", " << (int)move.middle << ")";
   return out;
 }
 
 
-int board_size(const Board& board) {
-  for (int i = 0; ; i++) {
-    assert(i * i <= board.size());
-    if (i * i == board.size())
-      return i;
+// What apply_all found, like Validation for MoveValidator.
+struct ApplyResult {
+  bool ok = true;
+  int index = -1;  // of the first illegal move, if not ok
+  string error;  // why it is illegal
+};
+
+// Applies moves in order, keeping what they jump over in consumed. With
+// CHECKED, stops at the first illegal one, undoes the ones before it and
+// says which one it was.
+template<ApplyPolicy policy = UNCHECKED>
+ApplyResult apply_all(
+    Board &board, const vector<Move> &moves, vector<Cell> &consumed) {
+  ApplyResult result;
+  for (int k = 0; k < moves.size(); k++) {
+    const char *reason =
+        policy == CHECKED ? moves[k].illegal_reason(board) : nullptr;
+    if (reason != nullptr) {
+      for (int i = k - 1; i >= 0; i--)
+        moves[i].undo(board, consumed);
+      result.ok = false;
+      result.index = k;
+      result.error = reason;
+      return result;
+    }
+    moves[k].apply(board, consumed);
   }
+  return result;
+}
+
+template<ApplyPolicy policy = UNCHECKED>
+ApplyResult apply_all(Board &board, const vector<Move> &moves) {
+  if (policy == CHECKED) {
+    vector<Cell> consumed;
+    return apply_all<CHECKED>(board, moves, consumed);
+  }
+  for (const auto &move : moves)
+    move.apply(board);
+  return ApplyResult();
+}
+
+// Reverts apply_all(board, moves, consumed).
+void undo_all(Board &board, const vector<Move> &moves, vector<Cell> &consumed) {
+  for (int k = moves.size() - 1; k >= 0; k--)
+    moves[k].undo(board, consumed);
+}
+
+
+// Jumps of a path of cells, as longest_path_from makes them.
+vector<Move> path_to_moves(const vector<int> &path) {
+  vector<Move> result;
+  for (int i = 1; i < path.size(); i++) {
+    assert((path[i] - path[i - 1]) % 2 == 0);
+    result.emplace_back(path[i - 1], (path[i] - path[i - 1]) / 2);
+  }
+  return result;
+}
+
+
+// See validator.h for the format.
+PackedMove pack_move(int n, const Move &move) {
+  Direction dir = move.delta == -n ? DIR_UP :
+                  move.delta == 1 ? DIR_RIGHT :
+                  move.delta == n ? DIR_DOWN : DIR_LEFT;
+  assert(move.delta == -1 || dir != DIR_LEFT);
+  return PackedMove(move.start) << 2 | dir;
+}
+
+Move unpack_move(int n, PackedMove packed) {
+  const int deltas[] = {-n, 1, n, -1};
+  return Move(packed >> 2, deltas[packed & 3]);
+}
+
+
+int board_size(const Board& board) {
+  return board.side();
 }
 
 
@@ -89,7 +320,7 @@ string board_to_string(const Board& board) {
       if (board[i*n + j] == EMPTY)
         out << " .";
       else
-        out << " " << board[i*n + j];
+        out << " " << (int)board[i*n + j];
     }
     out << endl;
   }
@@ -182,13 +413,12 @@ string show_edges(const Board &board, int y0, int x0) {
     out << endl;
   }
 
+  // Join horizontal edges with their endpoints.
   string result = out.str();
-  for (int i = 0; i < result.size() - 2; i++) {
-    //cout << result.substr(0, 3) << endl;
-    if (result.substr(i, 3) == " - ") {
-      //assert(false);
-      result = result.replace(i, 3, "---");
-
+  for (int i = 0; i + 2 < result.size(); i++) {
+    if (result[i] == ' ' && result[i + 1] == '-' && result[i + 2] == ' ') {
+      result[i] = '-';
+      result[i + 2] = '-';
     }
   }
   return result;
@@ -209,6 +439,16 @@ bool moves_commute(const Move &move1, const Move &move2) {
 }
 
 
+// Cells touched by a path of jumps: all visited cells and all jumped-over
+// middles. Paths with disjoint footprints commute.
+vector<int> path_footprint(const vector<int> &path) {
+  vector<int> result(path);
+  for (int i = 1; i < path.size(); i++)
+    result.push_back((path[i - 1] + path[i]) / 2);
+  return result;
+}
+
+
 vector<Move> moves_in_a_box(int n, int i1, int j1, int i2, int j2) {
   vector<Move> result;
   for (int i = i1; i < i2; i++) {
@@ -246,6 +486,54 @@ vector<Move> transpose_moves(int n, const vector<Move> &moves) {
 }
 
 
+// Game score of the whole move sequence, or -1 if some move is illegal.
+// Consecutive moves of the same peg form one path, as in moves_to_strings.
+long long moves_score(const Board &board, const vector<Move> &moves) {
+  Validation v = MoveValidator(board).replay(moves);
+  return v.ok ? v.score : -1;
+}
+
+
+// Best validated move list seen so far by a solve, shared with the threads
+// that may ask for it before the solve is over.
+class BestMoves {
+public:
+  explicit BestMoves(const Board &initial) : initial(initial) {}
+
+  // Keeps moves if they are legal from the initial board and score better.
+  // Returns whether they were kept.
+  bool offer(const vector<Move> &moves) {
+    long long new_score = moves_score(initial, moves);
+    lock_guard<mutex> lock(m);
+    if (new_score <= score)
+      return false;
+    score = new_score;
+    this->moves = moves;
+    improvements++;
+    return true;
+  }
+
+  vector<Move> get(long long *score_out = nullptr) const {
+    lock_guard<mutex> lock(m);
+    if (score_out)
+      *score_out = score;
+    return moves;
+  }
+
+  int num_improvements() const {
+    lock_guard<mutex> lock(m);
+    return improvements;
+  }
+
+private:
+  const Board initial;
+  mutable mutex m;
+  vector<Move> moves;
+  long long score = 0;
+  int improvements = 0;
+};
+
+
 int path_score(const Board &board, const vector<Move> &moves) {
   for (int i = 1; i < moves.size(); i++) {
     assert(moves[i - 1].start + 2 * moves[i - 1].delta == moves[i].start);
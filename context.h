@@ -0,0 +1,263 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <atomic>
+#include "timers.h"
+#include "budget.h"
+#include "params.h"
+#include "telemetry.h"
+#include "pool.h"
+#include "watchdog.h"
+#include "cost_model.h"
+
+
+typedef tuple<int, int, uint64_t> CacheKey;
+
+class BestMoves;
+class SolveTrace;
+
+
+// Longest paths of earlier solves in the process, for processes that solve
+// many boards (daemon.cc). Like SolverContext::lp_cache, entries are only
+// candidates and get checked with is_path_in_graph. Keeps two generations of
+// at most max_size entries each: when the newer one is full, the older one
+// is dropped.
+class SharedPathCache {
+public:
+  explicit SharedPathCache(size_t max_size) : max_size(max_size) {}
+
+  bool find(const CacheKey &key, vector<int> &path) {
+    lock_guard<mutex> lock(m);
+    auto p = current.find(key);
+    if (p != current.end()) {
+      path = p->second;
+      return true;
+    }
+    p = previous.find(key);
+    if (p == previous.end())
+      return false;
+    path = p->second;
+    insert(key, path);
+    return true;
+  }
+
+  void merge(const map<CacheKey, vector<int>> &entries) {
+    lock_guard<mutex> lock(m);
+    for (const auto &kv : entries)
+      insert(kv.first, kv.second);
+  }
+
+  size_t size() {
+    lock_guard<mutex> lock(m);
+    return current.size() + previous.size();
+  }
+
+private:
+  size_t max_size;
+  mutex m;
+  map<CacheKey, vector<int>> current;
+  map<CacheKey, vector<int>> previous;
+
+  void insert(const CacheKey &key, const vector<int> &path) {
+    if (current.size() >= max_size) {
+      previous.swap(current);
+      current.clear();
+    }
+    current[key] = path;
+  }
+};
+
+
+// All mutable state of one solve: deadlines, timers, random state, caches and
+// stats. Everything that needs any of it takes the context as the first
+// argument, so solves with separate contexts can run concurrently in one
+// process.
+class SolverContext {
+public:
+  int get_time_counter = 0;
+  CostModel cost_model;
+  // Push and pop them with push_deadline and pop_deadline, which keep
+  // deadline_passed in sync with the innermost one.
+  vector<double> deadlines;
+  atomic<bool> deadline_passed{false};
+  // How late each popped deadline was popped, negative if early.
+  vector<double> overshoots;
+  // Wall seconds by TimeIt name.
+  map<string, double> timers;
+
+  unsigned int rand_state = 1;
+
+  // Both owned by whoever started the solve; null for plain getMoves.
+  // Once *cancelled is set, check_deadline reports every deadline as passed.
+  const atomic<bool> *cancelled = nullptr;
+  BestMoves *best_moves = nullptr;
+  // Shared by all stages, and by portfolio variants. Null runs loops inline.
+  TaskPool *pool = nullptr;
+
+  map<CacheKey, vector<int>> lp_cache;
+  // Owned by whoever started the solve; null if there is none.
+  SharedPathCache *shared_lp_cache = nullptr;
+  int shared_lp_cache_hits = 0;
+  // Records the stage rounds if set; owned by whoever started the solve.
+  SolveTrace *trace = nullptr;
+  map<tuple<int, int, int, int>, int> longest_path_stats;
+  #ifdef LP_TELEMETRY
+  LongestPathTelemetry lp_telemetry;
+  #endif
+
+  SolveLimits limits = limits_for_budget(FULL_BUDGET);
+  Params params;
+  StageBudget stage_budget;
+  // Fraction of starts skipped by bound in each collect_long_paths call.
+  vector<double> start_cut_ratios;
+  // (candidates, batch size, best score, time) per pick_long_paths call.
+  vector<tuple<int, int, int, double>> pick_long_paths_stats;
+
+  SolverContext() {}
+
+  ~SolverContext() {
+    DeadlineWatchdog::instance().disarm(&deadline_passed);
+  }
+
+  double get_time() {
+    get_time_counter++;
+    return ::get_time();
+  }
+
+  void add_work(WorkKind kind, double amount = 1) {
+    cost_model.add(kind, amount);
+  }
+
+  // Until the innermost deadline.
+  double time_left() {
+    assert(!deadlines.empty());
+    return deadlines.back() - get_time();
+  }
+
+  void push_deadline(double deadline) {
+    deadlines.push_back(deadline);
+    DeadlineWatchdog::instance().arm(&deadline_passed, deadline);
+  }
+
+  void pop_deadline() {
+    assert(!deadlines.empty());
+    overshoots.push_back(get_time() - deadlines.back());
+    deadlines.pop_back();
+    if (deadlines.empty()) {
+      DeadlineWatchdog::instance().disarm(&deadline_passed, false);
+    } else {
+      DeadlineWatchdog::instance().arm(&deadline_passed, deadlines.back());
+    }
+  }
+
+  void add_subdeadline(double fraction) {
+    assert(!deadlines.empty());
+    double now = get_time();
+    double remaining = deadlines.back() - now;
+    if (remaining < 0) {
+      LOG_STAT("DEADLINE_MISSED", remaining);
+      push_deadline(deadlines.back());
+      return;
+    }
+
+    push_deadline(now + remaining * fraction);
+  }
+
+  bool is_cancelled() const {
+    return cancelled && cancelled->load(memory_order_relaxed);
+  }
+
+  // Cheap enough for the innermost loops.
+  bool check_deadline() const {
+    return deadline_passed.load(memory_order_relaxed) || is_cancelled();
+  }
+
+  // For parallel loops, which can't touch the context from their tasks.
+  StopCondition stop_condition() const {
+    StopCondition stop;
+    stop.deadline_passed = &deadline_passed;
+    stop.cancelled = cancelled;
+    return stop;
+  }
+
+  int pool_size() const {
+    return pool ? pool->size() : 1;
+  }
+
+  // Runs body(i, slot) for i in [0, count) until the current deadline, see
+  // TaskPool::parallel_for.
+  void parallel_for(int count, const function<void(int, int)> &body) {
+    if (pool) {
+      pool->parallel_for(count, body, stop_condition());
+    } else {
+      auto stop = stop_condition();
+      for (int i = 0; i < count; i++)
+        if (!stop())
+          body(i, 0);
+    }
+  }
+
+  void set_deadline_from_now(double seconds) {
+    push_deadline(get_time() + seconds);
+  }
+
+  void print_overshoots(ostream &out) const {
+    // Upper bounds of the buckets in ms, the first one is for early pops.
+    const vector<double> bounds = {0, 1, 2, 5, 10, 20, 50, 100};
+    vector<int> hist(bounds.size() + 1);
+    double worst = 0;
+    for (double t : overshoots) {
+      int k = 0;
+      while (k < bounds.size() && t * 1000 >= bounds[k])
+        k++;
+      hist[k]++;
+      worst = max(worst, t);
+    }
+    out << "# deadline_overshoot_buckets_ms = " << bounds << endl;
+    out << "# deadline_overshoot_hist = " << hist << endl;
+    out << "# deadline_overshoot_max = " << worst << endl;
+    out << "# watchdog_latency_max = "
+        << DeadlineWatchdog::instance().max_latency() << endl;
+  }
+
+  int rand() {
+    return rand_r(&rand_state);
+  }
+
+  void srand(unsigned int seed) {
+    rand_state = seed;
+  }
+
+  void print_timers(ostream &out) const {
+    for (auto kv : timers) {
+      out << "# " << kv.first << "_time = " << kv.second << endl;
+    }
+  }
+};
+
+
+#ifdef USE_TIME_IT
+class TimeIt {
+private:
+  SolverContext &ctx;
+  string name;
+  double start;
+public:
+  // Wall clock, because sections like optimizing_patch run on the pool,
+  // and the calling thread's CPU time leaves out the other workers.
+  TimeIt(SolverContext &ctx, string name)
+    : ctx(ctx), name(name), start(get_time()) {
+  }
+  ~TimeIt() {
+    ctx.timers[name] += get_time() - start;
+  }
+};
+#else
+class TimeIt {
+public:
+  TimeIt(SolverContext &ctx, string name) {}
+};
+#endif
+
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <fstream>
+
+
+// A board file in the format main reads, e.g. inputs/N.txt saved by
+// grab_inputs.sh.
+struct CorpusBoard {
+  string filename;
+  vector<int> peg_values;
+  vector<string> rows;
+};
+
+
+CorpusBoard read_board(const string &filename) {
+  CorpusBoard result;
+  result.filename = filename;
+  ifstream in(filename);
+  int m;
+  in >> m;
+  result.peg_values.resize(m);
+  for (int &v : result.peg_values)
+    in >> v;
+  int n;
+  in >> n;
+  result.rows.resize(n);
+  for (auto &row : result.rows)
+    in >> row;
+  if (!in) {
+    cerr << "Can't read board " << filename << endl;
+    exit(1);
+  }
+  return result;
+}
+
+
+#endif
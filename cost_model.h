@@ -0,0 +1,231 @@
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <unordered_map>
+
+
+// Kinds of work the solver counts with SolverContext::add_work.
+enum WorkKind {
+  PATCH_NODE,  // PatchOptimizer nodes
+  BLOCK_NODE,  // SimpleOptimizer nodes in BlobPreprocessor
+  EXPANDER_BFS_STEP,
+  EXPANDER_FRONTIER_ITEM,
+  CYCLE_STEP,  // expand_cycle and absorb_cycles
+  ROUND_CELLS,  // n^2 per stage round, for the board scans of every round
+  NUM_WORK_KINDS
+};
+
+const char *const WORK_KIND_NAMES[NUM_WORK_KINDS] = {
+  "patch_node", "block_node",
+  "expander_bfs_step", "expander_frontier_item", "cycle_step",
+  "round_cells",
+};
+
+// Seconds per unit on the reference machine, fitted on the sample boards.
+const double PRIOR_WORK_COSTS[NUM_WORK_KINDS] = {
+  1e-7, 2.3e-7, 9e-7, 1e-7, 3e-7, 1e-6,
+};
+
+// host_speed() measurement on the reference machine when otherwise idle, in
+// seconds. It only scales the priors, which refit() corrects from observed
+// rounds anyway.
+const double REFERENCE_CALIBRATION_TIME = 8.2e-3;
+const double CALIBRATION_SECONDS = 0.03;
+const int MIN_CALIBRATION_RUNS = 3;
+
+// Until the mean relative error of its predictions is below this, the model
+// isn't trusted to predict stage rounds, see CostModel::predict_round.
+const double MAX_TRUSTED_MODEL_ERROR = 0.25;
+
+
+// Hash map traffic on a grid graph, like the long path stage. On a 30 x 30
+// grid, runs in different processes measured either about 1.0 or 1.5,
+// depending on where their heap happened to be.
+int calibration_workload() {
+  const int n = 80;
+  unordered_map<int, vector<int>> g;
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++) {
+      if (i + 1 < n) {
+        g[i * n + j].push_back((i + 1) * n + j);
+        g[(i + 1) * n + j].push_back(i * n + j);
+      }
+      if (j + 1 < n) {
+        g[i * n + j].push_back(i * n + j + 1);
+        g[i * n + j + 1].push_back(i * n + j);
+      }
+    }
+  int checksum = 0;
+  for (int start = 0; start < 10; start++) {
+    unordered_map<int, int> dist;
+    vector<int> queue = {start};
+    dist[start] = 0;
+    for (int k = 0; k < queue.size(); k++) {
+      int v = queue[k];
+      for (int w : g[v])
+        if (dist.count(w) == 0) {
+          dist[w] = dist[v] + 1;
+          queue.push_back(w);
+        }
+    }
+    checksum += dist.size();
+  }
+  return checksum;
+}
+
+
+// How much faster than the reference machine this one is, measured once per
+// process. Takes the best of all runs in CALIBRATION_SECONDS, because other
+// threads, page faults and cold caches only ever make a run slower.
+double host_speed() {
+  static double speed = []() {
+    double best = 1e9;
+    volatile int sink = 0;
+    double end = get_time() + CALIBRATION_SECONDS;
+    for (int k = 0; k < MIN_CALIBRATION_RUNS || get_time() < end; k++) {
+      double start = get_time();
+      sink += calibration_workload();
+      best = min(best, get_time() - start);
+    }
+    return REFERENCE_CALIBRATION_TIME / max(best, 1e-6);
+  }();
+  return speed;
+}
+
+
+// Predicts running times from counted work. Costs per unit start from the
+// priors scaled by host_speed() and are refitted after every observed
+// segment (a stage round): least squares over all segments so far,
+// regularized towards the scaled priors so that kinds that rarely occur keep
+// sensible costs.
+class CostModel {
+public:
+  double speed;
+  double costs[NUM_WORK_KINDS];
+  double units[NUM_WORK_KINDS] = {};
+
+  // Work counters and time at the start of a segment.
+  struct Mark {
+    double units[NUM_WORK_KINDS];
+    double time;
+  };
+
+  CostModel() : speed(host_speed()) {
+    for (int k = 0; k < NUM_WORK_KINDS; k++)
+      costs[k] = PRIOR_WORK_COSTS[k] / speed;
+  }
+
+  void add(WorkKind kind, double amount) {
+    units[kind] += amount;
+  }
+
+  Mark mark() const {
+    Mark m;
+    copy(units, units + NUM_WORK_KINDS, m.units);
+    m.time = get_time();
+    return m;
+  }
+
+  // Records the segment since the mark as a round of the stage, and refits.
+  void observe(const string &stage, const Mark &since) {
+    vector<double> delta(NUM_WORK_KINDS);
+    for (int k = 0; k < NUM_WORK_KINDS; k++)
+      delta[k] = units[k] - since.units[k];
+    double time = get_time() - since.time;
+
+    double predicted = predict(delta);
+    if (time > 1e-4) {
+      errors.push_back(fabs(predicted - time) / time);
+    }
+    samples.emplace_back(delta, time);
+    last_round[stage] = delta;
+    last_round_time[stage] = time;
+    refit();
+  }
+
+  // Time of another round of the stage like the last one, 0 if none yet.
+  // That is the time the last round took, until the model's predictions
+  // have been within MAX_TRUSTED_MODEL_ERROR.
+  double predict_round(const string &stage) const {
+    auto p = last_round.find(stage);
+    if (p == last_round.end())
+      return 0.0;
+    if (errors.empty() || mean_error() > MAX_TRUSTED_MODEL_ERROR)
+      return last_round_time.at(stage);
+    return predict(p->second);
+  }
+
+  double predict(const vector<double> &amounts) const {
+    double result = 0;
+    for (int k = 0; k < NUM_WORK_KINDS; k++)
+      result += costs[k] * amounts[k];
+    return result;
+  }
+
+  void print(ostream &out) const {
+    out << "# host_speed = " << speed << endl;
+    for (int k = 0; k < NUM_WORK_KINDS; k++) {
+      out << "# cost_" << WORK_KIND_NAMES[k] << " = " << costs[k] << endl;
+      out << "# work_" << WORK_KIND_NAMES[k] << " = " << units[k] << endl;
+    }
+    out << "# cost_model_rounds = " << errors.size() << endl;
+    out << "# cost_model_mean_error = " << mean_error() << endl;
+  }
+
+  double mean_error() const {
+    double result = 0;
+    for (double e : errors)
+      result += e / errors.size();
+    return result;
+  }
+
+private:
+  // (work per kind, seconds)
+  vector<pair<vector<double>, double>> samples;
+  map<string, vector<double>> last_round;
+  map<string, double> last_round_time;
+  // Relative error of each prediction made before its segment was fitted.
+  vector<double> errors;
+
+  // Coordinate descent on multipliers x of the scaled priors, x >= 0,
+  // minimizing squared error plus REGULARIZATION * sum (x - 1)^2 relative to
+  // the mean squared segment time.
+  void refit() {
+    const double REGULARIZATION = 0.1;
+    vector<vector<double>> f;  // predicted seconds by the prior, per kind
+    double scale = 0;
+    for (const auto &s : samples) {
+      vector<double> row(NUM_WORK_KINDS);
+      for (int k = 0; k < NUM_WORK_KINDS; k++)
+        row[k] = PRIOR_WORK_COSTS[k] / speed * s.first[k];
+      f.push_back(row);
+      scale += s.second * s.second / samples.size();
+    }
+    double lambda = REGULARIZATION * max(scale, 1e-12);
+
+    vector<double> x(NUM_WORK_KINDS);
+    for (int k = 0; k < NUM_WORK_KINDS; k++)
+      x[k] = costs[k] * speed / PRIOR_WORK_COSTS[k];
+    for (int sweep = 0; sweep < 20; sweep++) {
+      for (int k = 0; k < NUM_WORK_KINDS; k++) {
+        // Minimize over x[k] alone.
+        double a = lambda;
+        double b = lambda;
+        for (int s = 0; s < samples.size(); s++) {
+          double rest = samples[s].second;
+          for (int q = 0; q < NUM_WORK_KINDS; q++)
+            if (q != k)
+              rest -= x[q] * f[s][q];
+          a += f[s][k] * f[s][k];
+          b += f[s][k] * rest;
+        }
+        x[k] = max(0.0, b / a);
+      }
+    }
+    for (int k = 0; k < NUM_WORK_KINDS; k++)
+      costs[k] = x[k] * PRIOR_WORK_COSTS[k] / speed;
+  }
+};
+
+
+#endif
@@ -0,0 +1,269 @@
+// Long-lived solver process. Reads boards in the format main reads, one after
+// another, and answers each in main's output format, in order. Boards come
+// from stdin, or from connections to a Unix socket with -socket. Up to
+// -concurrency boards are solved at once; they share one thread pool, and
+// longest paths found for one board are reused for the next ones.
+//
+// A malformed board is answered with "-1" and ends its stream.
+//
+// g++ --std=c++11 -O2 -pthread daemon.cc -o daemon
+// ./daemon -budget fast -concurrency 2 < boards.txt
+// ./daemon -budget fast -socket /tmp/pegs.sock
+
+#include <iostream>
+#include <fstream>
+#include <future>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "pretty_printing.h"
+
+using namespace std;
+
+#include "sol.cc"
+#include "embed.h"
+
+
+// Answers of a connection that are solved or being solved but not written
+// yet. Beyond this, the daemon stops reading the connection's boards until
+// the client reads its answers.
+const int MAX_PENDING_ANSWERS = 16;
+
+
+// Counting semaphore for the number of boards solved at once.
+class SolveSlots {
+public:
+  explicit SolveSlots(int count) : free(max(1, count)) {}
+
+  void acquire() {
+    unique_lock<mutex> lock(m);
+    cv.wait(lock, [this]() { return free > 0; });
+    free--;
+  }
+
+  void release() {
+    {
+      lock_guard<mutex> lock(m);
+      free++;
+    }
+    cv.notify_one();
+  }
+
+private:
+  mutex m;
+  condition_variable cv;
+  int free;
+};
+
+
+class Daemon {
+public:
+  Daemon(const PegJumping &solver, int concurrency, size_t cache_size)
+      : solver(solver), slots(concurrency),
+        pool(solver.pool_size), lp_cache(cache_size) {
+    this->solver.pool = &pool;
+    this->solver.lp_cache = &lp_cache;
+    // Concurrent boards already keep the cores busy.
+    this->solver.portfolio_size = 1;
+  }
+
+  // Answers the boards read from in_fd on out_fd until in_fd is closed.
+  // Boards are solved as soon as they are read and a slot is free, and
+  // answers are written in order by a separate thread, so clients may wait
+  // for each answer before sending the next board, or send many at once.
+  // The next board isn't read while this one waits for a slot or too many
+  // answers are pending, so a client can't make the daemon start more
+  // threads or hold more boards than that.
+  void serve(int in_fd, int out_fd) {
+    mutex m;
+    condition_variable cv;
+    deque<future<string>> answers;
+    bool reading = true;
+
+    thread writer([&]() {
+      while (true) {
+        future<string> answer;
+        {
+          unique_lock<mutex> lock(m);
+          cv.wait(lock, [&]() { return !answers.empty() || !reading; });
+          if (answers.empty())
+            return;
+          answer = move(answers.front());
+        }
+        write_all(out_fd, answer.get());
+        {
+          lock_guard<mutex> lock(m);
+          answers.pop_front();
+        }
+        cv.notify_all();
+      }
+    });
+
+    FdReader in(in_fd);
+    while (true) {
+      {
+        unique_lock<mutex> lock(m);
+        cv.wait(lock, [&]() { return answers.size() < MAX_PENDING_ANSWERS; });
+      }
+      int m_values;
+      if (!in.read_int(m_values))
+        break;
+      Board board;
+      int n;
+      bool ok = read_board(in, m_values, board, n);
+      if (ok)
+        slots.acquire();
+      {
+        lock_guard<mutex> lock(m);
+        if (ok)
+          answers.push_back(async(launch::async, [this, board, n]() {
+            return solve(board, n);
+          }));
+        else
+          answers.push_back(async(launch::deferred, []() {
+            return string("-1\n");
+          }));
+      }
+      cv.notify_all();
+      if (!ok)
+        break;
+    }
+
+    {
+      lock_guard<mutex> lock(m);
+      reading = false;
+    }
+    cv.notify_all();
+    writer.join();
+  }
+
+private:
+  PegJumping solver;
+  SolveSlots slots;
+  TaskPool pool;
+  SharedPathCache lp_cache;
+
+  // The rest of a board after its number of peg values.
+  static bool read_board(FdReader &in, int m, Board &board, int &n) {
+    if (m < 0 || m > 10)
+      return false;
+    vector<int> peg_values(m);
+    for (int &v : peg_values)
+      if (!in.read_int(v))
+        return false;
+    if (!in.read_int(n) || n <= 0)
+      return false;
+    vector<char> cells(n * n);
+    for (int i = 0; i < n; i++)
+      if (!in.read_token(&cells[i * n], n))
+        return false;
+    return board_from_grid(
+        GridView{cells.data(), n, n, peg_values.data(), m}, board);
+  }
+
+  // Releases the slot that serve acquired for the board.
+  string solve(const Board &board, int n) {
+    SolverContext ctx;
+    // solve() sets fields of the solver, so every board gets a copy.
+    PegJumping board_solver = solver;
+    vector<Move> moves = board_solver.solve(ctx, board);
+    slots.release();
+    string result;
+    append_moves_text(n, moves, result);
+    return result;
+  }
+};
+
+
+int listen_on(const string &path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof address.sun_path) {
+    cerr << "Socket path too long: " << path << endl;
+    return -1;
+  }
+  strcpy(address.sun_path, path.c_str());
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path.c_str());
+  if (fd < 0 ||
+      bind(fd, (sockaddr*)&address, sizeof address) < 0 ||
+      listen(fd, 16) < 0) {
+    cerr << "Can't listen on " << path << ": " << strerror(errno) << endl;
+    return -1;
+  }
+  return fd;
+}
+
+
+int main(int argc, char **argv) {
+  PegJumping solver;
+  int concurrency = 1;
+  size_t cache_size = 1 << 16;
+  string socket_path;
+  log_level = LOG_OFF;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "-budget" && has_value) {
+      double seconds;
+      if (!parse_budget(argv[++i], seconds)) {
+        cerr << "Bad budget " << argv[i] << endl;
+        return 1;
+      }
+      solver.limits = limits_for_budget(seconds);
+    } else if (arg == "-concurrency" && has_value) {
+      concurrency = atoi(argv[++i]);
+    } else if (arg == "-pool" && has_value) {
+      solver.pool_size = atoi(argv[++i]);
+    } else if (arg == "-cache" && has_value) {
+      cache_size = atoi(argv[++i]);
+    } else if (arg == "-params" && has_value) {
+      if (!solver.params.load(argv[++i]))
+        return 1;
+    } else if (arg == "-socket" && has_value) {
+      socket_path = argv[++i];
+    } else {
+      cerr << "usage: daemon [-budget tier_or_seconds] [-concurrency k] "
+           << "[-pool threads] [-cache entries] [-params params.txt] "
+           << "[-socket path]" << endl;
+      return 1;
+    }
+  }
+  if (getenv("LOG_LEVEL") != nullptr) {
+    int level;
+    if (!parse_log_level(getenv("LOG_LEVEL"), level)) {
+      cerr << "Bad LOG_LEVEL " << getenv("LOG_LEVEL") << endl;
+      return 1;
+    }
+    log_level = level;
+  }
+
+  test_bitpowersets();
+  Daemon daemon(solver, concurrency, cache_size);
+
+  if (socket_path.empty()) {
+    daemon.serve(0, 1);
+    return 0;
+  }
+
+  // Clients that hang up shouldn't take the daemon down with them.
+  signal(SIGPIPE, SIG_IGN);
+  int listen_fd = listen_on(socket_path);
+  if (listen_fd < 0)
+    return 1;
+  while (true) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      cerr << "accept: " << strerror(errno) << endl;
+      return 1;
+    }
+    thread([&daemon, fd]() {
+      daemon.serve(fd, fd);
+      close(fd);
+    }).detach();
+  }
+}
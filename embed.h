@@ -0,0 +1,176 @@
+#ifndef EMBED_H
+#define EMBED_H
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+
+// Entry points for callers that run the solver in-process on boards they
+// already have in memory, without going through strings, and the fast
+// stdin/stdout adapter main is built on.
+
+
+// n rows of n cells, row i starting at cells + i * stride. '.' is an empty
+// cell and digit d a peg worth peg_values[d] (1 to MAX_PEG_VALUE). Nothing is copied; the memory
+// only has to stay valid during the call it is passed to.
+struct GridView {
+  const char *cells;
+  int n;
+  int stride;
+  const int *peg_values;
+  int num_peg_values;
+};
+
+// Returns false if some cell is neither '.' nor the digit of a valid peg
+// value.
+bool board_from_grid(const GridView &grid, Board &board) {
+  int n = grid.n;
+  board.resize(n * n);
+  for (int i = 0; i < n; i++) {
+    const char *row = grid.cells + (size_t)i * grid.stride;
+    for (int j = 0; j < n; j++) {
+      char c = row[j];
+      if (c == '.') {
+        board[i * n + j] = EMPTY;
+      } else {
+        int d = c - '0';
+        if (d < 0 || d > 9 || d >= grid.num_peg_values ||
+            grid.peg_values[d] <= EMPTY || grid.peg_values[d] > MAX_PEG_VALUE)
+          return false;
+        board[i * n + j] = grid.peg_values[d];
+      }
+    }
+  }
+  return true;
+}
+
+
+// Solves the grid and writes the first min(result, capacity) moves of the
+// solution to moves. Every jump removes a peg, so a capacity of n * n always
+// suffices, and a prefix of the moves is still a legal sequence. Returns the
+// number of moves of the whole solution, or -1 if the grid is malformed.
+int solve_grid(
+    PegJumping &solver, const GridView &grid,
+    PackedMove *moves, int capacity) {
+  Board board;
+  if (!board_from_grid(grid, board))
+    return -1;
+  SolverContext ctx;
+  vector<Move> result = solver.solve(ctx, board);
+  for (int k = 0; k < result.size() && k < capacity; k++)
+    moves[k] = pack_move(grid.n, result[k]);
+  return result.size();
+}
+
+
+// Reads tokens from a file descriptor through its own buffer. Only reads as
+// much as it needs, because the tester doesn't close our stdin.
+class FdReader {
+public:
+  explicit FdReader(int fd) : fd(fd) {}
+
+  bool read_int(int &x) {
+    if (!skip_space())
+      return false;
+    bool negative = false;
+    if (buf[pos] == '-') {
+      negative = true;
+      pos++;
+    }
+    x = 0;
+    bool any = false;
+    while ((pos < len || refill()) && buf[pos] >= '0' && buf[pos] <= '9') {
+      x = x * 10 + (buf[pos++] - '0');
+      any = true;
+    }
+    if (negative)
+      x = -x;
+    return any;
+  }
+
+  // Reads the next size non-space characters into dst. Doesn't look past
+  // them, so that it never waits for input that isn't coming.
+  bool read_token(char *dst, int size) {
+    if (!skip_space())
+      return false;
+    for (int k = 0; k < size; k++) {
+      if (pos == len && !refill())
+        return false;
+      if (isspace(buf[pos]))
+        return false;
+      dst[k] = buf[pos++];
+    }
+    return true;
+  }
+
+private:
+  int fd;
+  char buf[1 << 16];
+  int pos = 0;
+  int len = 0;
+
+  bool refill() {
+    ssize_t r;
+    do {
+      r = ::read(fd, buf, sizeof buf);
+    } while (r < 0 && errno == EINTR);
+    pos = 0;
+    len = max<ssize_t>(r, 0);
+    return len > 0;
+  }
+
+  bool skip_space() {
+    while (true) {
+      if (pos == len && !refill())
+        return false;
+      if (!isspace(buf[pos]))
+        return true;
+      pos++;
+    }
+  }
+};
+
+
+// Appends the moves in the output format of getMoves: the number of lines,
+// then "row column directions" for every chain of jumps by one peg.
+void append_moves_text(int n, const vector<Move> &moves, string &out) {
+  string lines;
+  int num_lines = 0;
+  int last = -1;
+  char number[16];
+  for (const auto &move : moves) {
+    if (move.start != last) {
+      if (num_lines > 0)
+        lines += '\n';
+      num_lines++;
+      lines.append(number, snprintf(number, sizeof number, "%d %d ",
+                                    move.start / n, move.start % n));
+    }
+    lines += delta_to_char(move.delta);
+    last = move.start + 2 * move.delta;
+  }
+  out.append(number, snprintf(number, sizeof number, "%d\n", num_lines));
+  out += lines;
+  if (num_lines > 0)
+    out += '\n';
+}
+
+
+bool write_all(int fd, const string &s) {
+  size_t done = 0;
+  while (done < s.size()) {
+    ssize_t w = ::write(fd, s.data() + done, s.size() - done);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return false;
+    done += w;
+  }
+  return true;
+}
+
+
+#endif
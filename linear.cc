@@ -64,11 +64,10 @@ bool can_reach(int n, Board &board, vector<int> poss) {
 
 int main() {
   int n = 20;
-  Board board;
+  Board board(n * n);
   for (int i = 0; i < n * n; i++) {
-    board.push_back(EMPTY);
     if (rand() % 1000 < 150)
-      board.back() = rand() % 9 + 1;
+      board[i] = rand() % 9 + 1;
   }
 
   // for (int i = 4; i < 6; i++)
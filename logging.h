@@ -0,0 +1,90 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+
+// Verbosity of the solver's stderr output. Stats are the "# key = value"
+// lines run_all.py collects, info is other short progress notes, and debug
+// adds whole board dumps, which are slow to format and huge on big boards.
+enum LogLevel {
+  LOG_OFF,
+  LOG_STATS,
+  LOG_INFO,
+  LOG_DEBUG,
+};
+
+// Output above this level is compiled out.
+#ifndef MAX_LOG_LEVEL
+#define MAX_LOG_LEVEL LOG_DEBUG
+#endif
+
+// Set from LOG_LEVEL by main.
+std::atomic<int> log_level(LOG_INFO);
+
+bool log_enabled(int level) {
+  return level <= MAX_LOG_LEVEL &&
+         level <= log_level.load(std::memory_order_relaxed);
+}
+
+bool parse_log_level(const std::string &s, int &level) {
+  const char *const names[] = {"off", "stats", "info", "debug"};
+  for (int k = LOG_OFF; k <= LOG_DEBUG; k++)
+    if (s == names[k] || s == std::to_string(k)) {
+      level = k;
+      return true;
+    }
+  return false;
+}
+
+
+// Collects one message and writes it to stderr in one piece when destroyed,
+// so that messages of concurrent solves don't interleave. Ends it with a
+// newline unless it already has one.
+class LogMessage {
+public:
+  template<typename T>
+  LogMessage &operator<<(const T &x) {
+    out << x;
+    return *this;
+  }
+
+  // For print(ostream &) methods.
+  std::ostream &stream() {
+    return out;
+  }
+
+  ~LogMessage() {
+    std::string s = out.str();
+    if (s.empty() || s.back() != '\n')
+      s += '\n';
+    static std::mutex m;
+    std::lock_guard<std::mutex> lock(m);
+    std::cerr << s;
+  }
+
+private:
+  std::ostringstream out;
+};
+
+
+// Turns LOG into an expression, because & binds looser than <<.
+struct LogVoidify {
+  void operator&(const LogMessage &) {}
+};
+
+// LOG(LOG_INFO) << ...; Nothing after LOG(level) is evaluated unless the
+// level is enabled.
+#define LOG(level) \
+  !log_enabled(level) ? (void)0 : LogVoidify() & LogMessage()
+
+// "# key = value" line; value must print as a Python literal.
+#define LOG_STAT(key, value) \
+  LOG(LOG_STATS) << "# " << (key) << " = " << (value)
+
+
+#endif
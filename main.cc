@@ -1,4 +1,5 @@
 #include <iostream>
+#include <fstream>
 
 #include "pretty_printing.h"
 
@@ -7,33 +8,88 @@ using namespace std;
 
 // Terrible, but it's topcoder. Everything should be in one file.
 #include "sol.cc"
+#include "embed.h"
 
 
 int main(int argc, char **argv) {
   test_bitpowersets();
 
-  int m;
-  cin >> m;
-  vector<int> peg_values;
-  for (int i = 0; i < m; i++) {
-    peg_values.push_back(-1);
-    cin >> peg_values.back();
+
+  FdReader in(0);
+  int m = 0;
+  bool ok = in.read_int(m) && m >= 0;
+  vector<int> peg_values(ok ? m : 0);
+  for (int &v : peg_values)
+    ok = ok && in.read_int(v);
+  int n = 0;
+  ok = ok && in.read_int(n) && n >= 0;
+  vector<char> cells(ok ? n * n : 0);
+  for (int i = 0; ok && i < n; i++)
+    ok = in.read_token(&cells[i * n], n);
+
+  Board board;
+  if (!ok ||
+      !board_from_grid(GridView{cells.data(), n, n, peg_values.data(), m}, board)) {
+    cerr << "Bad input" << endl;
+    return 1;
+  }
+
+  if (getenv("LOG_LEVEL") != nullptr) {
+    int level;
+    if (parse_log_level(getenv("LOG_LEVEL"), level))
+      log_level = level;
+    else
+      cerr << "Bad LOG_LEVEL " << getenv("LOG_LEVEL") << endl;
+  }
+
+  PegJumping solver;
+  if (getenv("PORTFOLIO_SIZE") != nullptr)
+    solver.portfolio_size = atoi(getenv("PORTFOLIO_SIZE"));
+  if (getenv("POOL_SIZE") != nullptr)
+    solver.pool_size = atoi(getenv("POOL_SIZE"));
+
+  // As written by tuner.
+  const char *params_file = getenv("PARAMS_FILE");
+  if (params_file == nullptr && ifstream("params.txt"))
+    params_file = "params.txt";
+  if (params_file != nullptr) {
+    solver.params.load(params_file);
+    LOG_STAT("params_file", "'" + string(params_file) + "'");
   }
-  int n;
-  cin >> n;
 
-  vector<string> board;
-  for (int i = 0; i < n; i++) {
-    board.push_back("");
-    cin >> board.back();
+  // Tier name (interactive, fast, full) or seconds.
+  if (getenv("TIME_BUDGET") != nullptr) {
+    double seconds;
+    if (parse_budget(getenv("TIME_BUDGET"), seconds))
+      solver.limits = limits_for_budget(seconds);
+    else
+      cerr << "Bad TIME_BUDGET, using the full budget" << endl;
   }
-  //cerr << board << endl;
 
-  vector<string> moves = PegJumping().getMoves(peg_values, board);
+  #ifdef LP_TELEMETRY
+  // Per block records of longest path queries, one JSON object per line.
+  ofstream lp_telemetry_dump;
+  if (getenv("LP_TELEMETRY_DUMP") != nullptr) {
+    lp_telemetry_dump.open(getenv("LP_TELEMETRY_DUMP"));
+    solver.lp_telemetry_dump = &lp_telemetry_dump;
+  }
+  #endif
+  // Binary SolveTrace for replay.cc. Lost if the solve hits the latency cap.
+  ofstream trace_file;
+  if (getenv("TRACE_FILE") != nullptr) {
+    trace_file.open(getenv("TRACE_FILE"), ios::binary);
+    solver.trace_out = &trace_file;
+  }
+  AnytimeSolve solve(solver, board);
+  string out;
+  append_moves_text(n, solve.wait(solver.limits.latency_cap()), out);
+  write_all(1, out);
 
-  cout << moves.size() << endl;
-  for (auto move : moves)
-    cout << move << endl;
+  if (!solve.finished()) {
+    // Don't let the abandoned solve outlive the streams it writes to.
+    cerr.flush();
+    _exit(0);
+  }
 
   return 0;
 }
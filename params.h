@@ -0,0 +1,149 @@
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <fstream>
+#include <cmath>
+
+
+// Magic numbers of the solver, searched over by tuner.cc. Defaults are the
+// hand-tuned values; a parameter file ("name = value" lines, as written by
+// write()) overrides them at startup.
+class Params {
+public:
+  // find_long_runs threshold in BlobPreprocessor.
+  int blob_min_run = 5;
+  // Block sides in BlobPreprocessor::optimize are
+  // blob_min_block + rand() % blob_block_range.
+  int blob_min_block = 4;
+  int blob_block_range = 5;
+  // SimpleOptimizer depth per rewarded cell of a block.
+  int block_depth_factor = 2;
+  // Endpoints inside a block tried by longest_path_from, besides bridges.
+  int inner_endpoints = 1;
+  // PatchOptimizer tile side, even.
+  int tile_size = 8;
+  // Boards of this side and up are solved region by region, in regions of
+  // about region_size (even) on a side.
+  int region_board_min = 200;
+  int region_size = 64;
+  // Patch optimization never takes more than this share of remaining time.
+  double patch_share = 0.3;
+  // Share of the remaining time for one sparsification round by region.
+  double region_sparsify_share = 0.25;
+  // Share of the remaining time for one pick_long_paths round.
+  double long_path_share = 0.8;
+  // Paths this much worse than the best one are left for the following
+  // rounds, because applying the best one can give them room to grow.
+  double min_batch_score_ratio = 0.5;
+
+  vector<string> names() {
+    vector<string> result;
+    for (const auto &kv : int_fields())
+      result.push_back(kv.first);
+    for (const auto &kv : double_fields())
+      result.push_back(kv.first);
+    return result;
+  }
+
+  bool is_int(const string &name) {
+    return int_fields().count(name) > 0;
+  }
+
+  double get(const string &name) {
+    auto ints = int_fields();
+    if (ints.count(name))
+      return *ints[name];
+    return *double_fields().at(name);
+  }
+
+  bool set(const string &name, double value) {
+    auto ints = int_fields();
+    auto doubles = double_fields();
+    if (ints.count(name))
+      *ints[name] = (int)round(value);
+    else if (doubles.count(name))
+      *doubles[name] = value;
+    else
+      return false;
+    return true;
+  }
+
+  void write(ostream &out) {
+    for (const auto &name : names())
+      out << name << " = " << get(name) << endl;
+  }
+
+  // Unknown names and malformed lines are reported and make it return
+  // false, but the rest of the file is still applied.
+  bool load(const string &filename) {
+    ifstream in(filename);
+    if (!in) {
+      cerr << "Can't read " << filename << endl;
+      return false;
+    }
+    bool ok = true;
+    string line;
+    while (getline(in, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+      istringstream line_in(line);
+      string name, eq;
+      double value;
+      if (!(line_in >> name >> eq >> value) || eq != "=" || !set(name, value)) {
+        cerr << "Bad line in " << filename << ": " << line << endl;
+        ok = false;
+      }
+    }
+    // PatchOptimizer keeps a tile in a Bitboard, a word per row.
+    if (tile_size % 2 != 0 || tile_size < 4 || tile_size > 64) {
+      cerr << "Bad tile_size in " << filename << ": " << tile_size << endl;
+      tile_size = Params().tile_size;
+      ok = false;
+    }
+    if (region_size % 2 != 0 || region_size < 2 * tile_size) {
+      cerr << "Bad region_size in " << filename << ": " << region_size << endl;
+      region_size = Params().region_size;
+      ok = false;
+    }
+    if (blob_block_range < 1) {
+      cerr << "Bad blob_block_range in " << filename << ": " << blob_block_range << endl;
+      blob_block_range = Params().blob_block_range;
+      ok = false;
+    }
+    // The doubles are all shares of time or score ratios. A share above 1
+    // would put a subdeadline past the solve's own deadline.
+    for (const auto &kv : double_fields())
+      if (!(*kv.second > 0 && *kv.second <= 1)) {
+        cerr << "Bad " << kv.first << " in " << filename << ": " << *kv.second << endl;
+        *kv.second = Params().get(kv.first);
+        ok = false;
+      }
+    return ok;
+  }
+
+private:
+  map<string, int*> int_fields() {
+    return {
+      {"blob_min_run", &blob_min_run},
+      {"blob_min_block", &blob_min_block},
+      {"blob_block_range", &blob_block_range},
+      {"block_depth_factor", &block_depth_factor},
+      {"inner_endpoints", &inner_endpoints},
+      {"tile_size", &tile_size},
+      {"region_board_min", &region_board_min},
+      {"region_size", &region_size},
+    };
+  }
+
+  map<string, double*> double_fields() {
+    return {
+      {"patch_share", &patch_share},
+      {"region_sparsify_share", &region_sparsify_share},
+      {"long_path_share", &long_path_share},
+      {"min_batch_score_ratio", &min_batch_score_ratio},
+    };
+  }
+};
+
+
+#endif
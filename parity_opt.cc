@@ -8,6 +8,7 @@ public:
   int n;
   Board board;
   vector<Move> moves, best_moves;
+  vector<Cell> consumed;  // by moves
   //vector<int> degrees;
   int score;
   int best_score;
@@ -52,12 +53,18 @@ public:
   }
 
   void rec() {
-    if (cnt > iteration_limit) {
-      return;
-    }
+    SearchEngine<Hz> engine(*this);
+    if (!engine.run(iteration_limit + 1LL - cnt))
+      engine.abandon();
+  }
+
+  // SearchEngine interface.
+  typedef Move Step;
+
+  bool visit() {
     cnt++;
     // if (score_upper_bound() <= best_score) {
-    //   return;
+    //   return false;
     // }
 
     int score = naive_compute_score();
@@ -66,29 +73,29 @@ public:
       best_score = score;
       best_moves = moves;
     }
+    return true;
+  }
+
+  void expand(vector<Move> &steps) {
     for (int pos = 0; pos < n*n; pos++) {
       if (board[pos] == EMPTY)
         continue;
       int i = pos / n;
       int j = pos % n;
 
-      if (j >= 2) try_move(pos, -1);
-      if (j < n - 2) try_move(pos, 1);
-      if (i >= 2) try_move(pos, -n);
-      if (i < n - 2) try_move(pos, n);
+      if (j >= 2) try_move(steps, pos, -1);
+      if (j < n - 2) try_move(steps, pos, 1);
+      if (i >= 2) try_move(steps, pos, -n);
+      if (i < n - 2) try_move(steps, pos, n);
     }
   }
 
-  void try_move(int pos, int delta) {
+  void try_move(vector<Move> &steps, int pos, int delta) {
     if (board.at(pos + delta) == EMPTY)
       return;
     if (board.at(pos + 2*delta) != EMPTY)
       return;
 
-    assert(board[pos] != EMPTY);
-    assert(board[pos + delta] != EMPTY);
-    assert(board[pos + 2*delta] == EMPTY);
-
     if (!moves.empty()) {
       int last_pos = moves.back().start;
       int last_delta = moves.back().delta;
@@ -96,19 +103,17 @@ public:
           moves_commute(pos, delta, last_pos, last_delta))
         return;
     }
+    steps.emplace_back(pos, delta);
+  }
 
-    Cell consumed = board[pos + delta];
-    board[pos + delta] = EMPTY;
-    board[pos + 2*delta] = board[pos];
-    board[pos] = EMPTY;
+  void apply(const Move &move) {
+    move.apply(board, consumed);
+    moves.push_back(move);
+  }
 
-    moves.emplace_back(pos, delta);
-    rec();
+  void undo(const Move &move) {
     moves.pop_back();
-
-    board[pos] = board[pos + 2*delta];
-    board[pos + 2*delta] = EMPTY;
-    board[pos + delta] = consumed;
+    move.undo(board, consumed);
   }
 
 };
@@ -116,12 +121,11 @@ public:
 
 int main() {
   int n = 11;
-  Board board;
+  Board board(n * n);
   for (int i = 0; i < n * n; i++) {
-    board.push_back(EMPTY);
     int p = (i % n + i / n) % 2 == 1 ? 350 : 450;
     if (rand() % 1000 < p)
-      board.back() = 1;
+      board[i] = 1;
   }
 
   cerr << board_to_string(board) << endl;
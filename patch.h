@@ -1,27 +1,33 @@
 
+// Searches the moves on a tile (of side at most 64) that leave the most
+// pegs isolated on edges of the preferred parity. Keeps the pegs in a
+// Bitboard too, to generate moves and count by rows.
 class PatchOptimizer {
 public:
   int n;
   Board board;
+  Bitboard occupied;
   vector<Move> moves, best_moves;
+  vector<Cell> consumed;  // by moves
   int best_score;
   int cnt;
   int iteration_limit;
 
   PatchOptimizer(Board board, int iteration_limit=1000000000)
-      : board(board), iteration_limit(iteration_limit) {
+      : board(board), occupied(board), iteration_limit(iteration_limit) {
     n = board_size(board);
     best_score = -1;
     best_score = score_upper_bound() - 10;
     cnt = 0;
   }
 
+  // Pegs on cells with row and column of different parity.
   int score_upper_bound() {
     int result = 0;
     for (int i = 0; i < n; i++)
-      for (int j = 0; j < n; j++)
-        if (i % 2 != j % 2 && board[i * n + j] != EMPTY)
-          result++;
+      result += __builtin_popcountll(
+          occupied.rows[i] &
+          (i % 2 == 0 ? occupied.odd_columns : occupied.even_columns));
     return result;
   }
 
@@ -29,24 +35,17 @@ public:
     int num_edges = 0;
 
     for (int i = 0; i < n; i++) {
-      for (int j = 0; j < n; j++) {
-        int pos = i * n + j;
-
-        if (i % 2 == 0 && j % 2 == 1) {
-          // horizontal edge
-          if (board[pos] != EMPTY &&
-              (j == 0 || board[pos - 1] == EMPTY) &&
-              (j == n - 1 || board[pos + 1] == EMPTY))
-            num_edges++;
-        }
-
-        if (i % 2 == 1 && j % 2 == 0) {
-          // vertical edge
-          if (board[pos] != EMPTY &&
-              (i == 0 || board[pos - n] == EMPTY) &&
-              (i == n - 1 || board[pos + n] == EMPTY))
-              num_edges++;
-        }
+      uint64_t row = occupied.rows[i];
+      if (i % 2 == 0) {
+        // horizontal edges, cells off the board count as empty
+        num_edges += __builtin_popcountll(
+            row & occupied.odd_columns & ~(row << 1) & ~(row >> 1));
+      } else {
+        // vertical edges
+        uint64_t above = occupied.rows[i - 1];
+        uint64_t below = i + 1 < n ? occupied.rows[i + 1] : 0;
+        num_edges += __builtin_popcountll(
+            row & occupied.even_columns & ~above & ~below);
       }
     }
 
@@ -54,13 +53,20 @@ public:
     return num_edges;
   }
 
+  // Runs the whole search, up to iteration_limit nodes.
   void rec() {
-    if (cnt > iteration_limit) {
-      return;
-    }
+    SearchEngine<PatchOptimizer> engine(*this);
+    if (!engine.run(iteration_limit + 1LL - cnt))
+      engine.abandon();
+  }
+
+  // SearchEngine interface.
+  typedef Move Step;
+
+  bool visit() {
     cnt++;
     if (score_upper_bound() <= best_score) {
-      return;
+      return false;
     }
 
     int score = naive_score();
@@ -69,28 +75,29 @@ public:
       best_score = score;
       best_moves = moves;
     }
-    for (int pos = 0; pos < n*n; pos++) {
-      if (board[pos] == EMPTY)
-        continue;
-      int i = pos / n;
-      int j = pos % n;
-
-      if (j >= 2) try_move(pos, -1);
-      if (j < n - 2) try_move(pos, 1);
-      if (i >= 2) try_move(pos, -n);
-      if (i < n - 2) try_move(pos, n);
-    }
+    return true;
   }
 
-  void try_move(int pos, int delta) {
-    if (board.at(pos + delta) == EMPTY)
-      return;
-    if (board.at(pos + 2*delta) != EMPTY)
-      return;
+  void expand(vector<Move> &steps) {
+    // In the order of pos, then left, right, up, down.
+    for (int i = 0; i < n; i++) {
+      uint64_t left = occupied.jumps(i, DIR_LEFT);
+      uint64_t right = occupied.jumps(i, DIR_RIGHT);
+      uint64_t up = occupied.jumps(i, DIR_UP);
+      uint64_t down = occupied.jumps(i, DIR_DOWN);
+      for (uint64_t any = left | right | up | down; any; any &= any - 1) {
+        int j = __builtin_ctzll(any);
+        int pos = i * n + j;
+        if (left >> j & 1) try_move(steps, pos, -1);
+        if (right >> j & 1) try_move(steps, pos, 1);
+        if (up >> j & 1) try_move(steps, pos, -n);
+        if (down >> j & 1) try_move(steps, pos, n);
+      }
+    }
+  }
 
-    assert(board[pos] != EMPTY);
-    assert(board[pos + delta] != EMPTY);
-    assert(board[pos + 2*delta] == EMPTY);
+  // The jump is legal.
+  void try_move(vector<Move> &steps, int pos, int delta) {
 
     if (!moves.empty()) {
       int last_pos = moves.back().start;
@@ -99,26 +106,35 @@ public:
           moves_commute(pos, delta, last_pos, last_delta))
         return;
     }
+    steps.emplace_back(pos, delta);
+  }
 
-    Cell consumed = board[pos + delta];
-    board[pos + delta] = EMPTY;
-    board[pos + 2*delta] = board[pos];
-    board[pos] = EMPTY;
+  void apply(const Move &move) {
+    int pos = move.start;
+    int delta = move.delta;
+    move.apply(board, consumed);
+    occupied.clear(pos);
+    occupied.clear(pos + delta);
+    occupied.set(pos + 2*delta);
+    moves.push_back(move);
+  }
 
-    moves.emplace_back(pos, delta);
-    rec();
+  void undo(const Move &move) {
+    int pos = move.start;
+    int delta = move.delta;
     moves.pop_back();
-
-    board[pos] = board[pos + 2*delta];
-    board[pos + 2*delta] = EMPTY;
-    board[pos + delta] = consumed;
+    move.undo(board, consumed);
+    occupied.set(pos);
+    occupied.set(pos + delta);
+    occupied.clear(pos + 2*delta);
   }
 };
 
 
+// Square part of a board, which has to outlive it.
 class Patcher {
 public:
-  Board board;
+  const Board &board;
   int n;
   int i0, j0, size;
 
@@ -148,7 +164,7 @@ public:
   //   }
   // }
 
-  vector<Move> translate_moves(const vector<Move> &patch_moves) {
+  vector<Move> translate_moves(const vector<Move> &patch_moves) const {
     vector<Move> result;
     for (const Move &move : patch_moves) {
       assert(move.middle == EMPTY);
@@ -170,60 +186,56 @@ public:
 };
 
 
-vector<Move> divide_and_optimize(Board board, int tile_size, int preferred_parity) {
-  TimeIt t("divide_and_optimize");
+vector<Move> divide_and_optimize(
+    SolverContext &ctx, Board board, int tile_size, int preferred_parity,
+    int rounds = 2) {
+  TimeIt t(ctx, "divide_and_optimize");
   assert(tile_size % 2 == 0);
   int n = board_size(board);
 
   vector<Move> all_moves;
 
-  for (int q = 0; q < 2; q++) {
-    if (check_deadline())
+  for (int q = 0; q < rounds; q++) {
+    if (ctx.check_deadline())
       break;
 
     vector<Patcher> patchers;
-    vector<Move> moves;
 
-    int base_i = (rand() % tile_size) / 2 * 2;
-    int base_j = (rand() % tile_size) / 2 * 2;
+    int base_i = (ctx.rand() % tile_size) / 2 * 2;
+    int base_j = (ctx.rand() % tile_size) / 2 * 2;
     for (int i = base_i + preferred_parity; i + tile_size <= n; i += tile_size) {
       for (int j = base_j; j + tile_size <= n; j += tile_size) {
-        if (check_deadline())
-          break;
         patchers.emplace_back(board, i, j, tile_size);
         //cerr << "tile at " << i << ", " << j << " of size " << tile_size << endl;
-        //cerr << "before:" << endl;
+      }
+    }
 
-        auto patch = patchers.back().get();
+    // Tiles don't overlap, so they are independent. Tiles not started by the
+    // deadline are left as they are.
+    vector<vector<Move>> tile_moves(patchers.size());
+    vector<int> tile_nodes(patchers.size());
+    {
+      TimeIt t(ctx, "optimizing_patch");
+      ctx.parallel_for(patchers.size(), [&](int k, int slot) {
+        auto patch = patchers[k].get();
         //cerr << show_edges(patch, 0, 0) << endl;
 
-        PatchOptimizer po(patch, 500000);
-        add_work(0.1);
-
-        {
-          TimeIt t("optimizing_patch");
-          po.rec();
-        }
-        for (auto move : po.best_moves) {
-          move.apply(patch);
-          moves.push_back(patchers.back().translate_moves({move}).front());
-        }
-
-        //auto patch_moves = po(patch)
-
-        //cerr << "after:" << endl;
-        //cerr << show_edges(patch, 0, 0) << endl;
-      }
+        PatchOptimizer po(patch, ctx.limits.patch_iterations);
+        po.rec();
+        tile_moves[k] = patchers[k].translate_moves(po.best_moves);
+        tile_nodes[k] = po.cnt;
+      });
     }
+    for (int nodes : tile_nodes)
+      ctx.add_work(PATCH_NODE, nodes);
 
-    for (auto move : moves) {
-      move.apply(board);
-      all_moves.push_back(move);
+    for (const auto &moves : tile_moves) {
+      apply_all(board, moves);
+      all_moves.insert(all_moves.end(), moves.begin(), moves.end());
     }
   }
 
-  cerr << "whole board after: " << endl;
-  cerr << show_edges(board, preferred_parity, 0) << endl;
-  cerr << endl;
+  LOG(LOG_DEBUG) << "whole board after: \n"
+                 << show_edges(board, preferred_parity, 0) << "\n";
   return all_moves;
 }
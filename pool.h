@@ -0,0 +1,159 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+// Tells parallel loops to skip the tasks that haven't started yet. Only
+// reads flags, so any thread can call it.
+struct StopCondition {
+  const atomic<bool> *deadline_passed = nullptr;
+  const atomic<bool> *cancelled = nullptr;
+
+  bool operator()() const {
+    return (deadline_passed && deadline_passed->load(memory_order_relaxed)) ||
+           (cancelled && cancelled->load(memory_order_relaxed));
+  }
+};
+
+
+// Threads shared by all parallel loops of a solve, so nested and concurrent
+// loops never run more than size() tasks at once.
+//
+// Every parallel_for is a group of tasks with a shared counter. Its caller
+// works through the group itself, and idle pool threads steal the next
+// unclaimed tasks, preferring the newest group (the innermost loop). A thread
+// waiting for a group only helps with that group, so the slot it passes to
+// the loop body is never in use by another task of the same group: slots
+// index per-worker scratch memory of the loop.
+class TaskPool {
+public:
+  explicit TaskPool(int num_threads) : num_threads(max(1, num_threads)) {
+    for (int k = 0; k + 1 < this->num_threads; k++)
+      threads.emplace_back([this, k]() { worker_loop(k); });
+  }
+
+  ~TaskPool() {
+    {
+      lock_guard<mutex> lock(m);
+      stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto &t : threads)
+      t.join();
+  }
+
+  int size() const {
+    return num_threads;
+  }
+
+  // Runs body(i, slot) for every i in [0, count), slot in [0, size()), and
+  // returns when all of them are done or skipped because of stop. Bodies
+  // should write their results by i and leave combining them to the caller,
+  // so the outcome doesn't depend on the number of threads.
+  void parallel_for(
+      int count, const function<void(int, int)> &body,
+      const StopCondition &stop = StopCondition()) {
+    int slot = current_slot >= 0 ? current_slot : num_threads - 1;
+    if (num_threads == 1 || count <= 1) {
+      for (int i = 0; i < count; i++)
+        if (!stop())
+          body(i, slot);
+      return;
+    }
+
+    Group group(count, body, stop);
+    {
+      lock_guard<mutex> lock(m);
+      groups.push_back(&group);
+    }
+    work_cv.notify_all();
+
+    while (run_one(group, slot)) {}
+
+    unique_lock<mutex> lock(m);
+    done_cv.wait(lock, [&group]() { return group.remaining == 0; });
+    groups.erase(find(groups.begin(), groups.end(), &group));
+  }
+
+private:
+  struct Group {
+    const function<void(int, int)> &body;
+    const StopCondition &stop;
+    int count;
+    atomic<int> next;
+    int remaining;  // guarded by TaskPool::m
+
+    Group(int count, const function<void(int, int)> &body,
+          const StopCondition &stop)
+        : body(body), stop(stop), count(count), next(0), remaining(count) {}
+  };
+
+  int num_threads;
+  vector<thread> threads;
+  mutex m;
+  condition_variable work_cv;
+  condition_variable done_cv;
+  vector<Group*> groups;  // active ones, innermost last
+  bool stopping = false;
+
+  static thread_local int current_slot;
+
+  // Claims and runs one task of the group. Returns false if none was left.
+  bool run_one(Group &group, int slot) {
+    int i = group.next++;
+    if (i >= group.count)
+      return false;
+    run(group, i, slot);
+    return true;
+  }
+
+  void run(Group &group, int i, int slot) {
+    if (!group.stop())
+      group.body(i, slot);
+    bool last;
+    {
+      lock_guard<mutex> lock(m);
+      last = --group.remaining == 0;
+    }
+    if (last)
+      done_cv.notify_all();
+  }
+
+  void worker_loop(int slot) {
+    current_slot = slot;
+    while (true) {
+      Group *group = nullptr;
+      int i;
+      {
+        unique_lock<mutex> lock(m);
+        // Claimed under the lock, because an unclaimed task doesn't keep
+        // the group from finishing and going away.
+        work_cv.wait(lock, [this, &group, &i]() {
+          for (int k = groups.size() - 1; k >= 0; k--) {
+            if (groups[k]->next >= groups[k]->count)
+              continue;
+            i = groups[k]->next++;
+            if (i < groups[k]->count) {
+              group = groups[k];
+              return true;
+            }
+          }
+          return stopping;
+        });
+        if (group == nullptr)
+          return;
+      }
+      run(*group, i, slot);
+    }
+  }
+};
+
+thread_local int TaskPool::current_slot = -1;
+
+
+#endif
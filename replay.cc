@@ -0,0 +1,221 @@
+// Reads a SolveTrace (see trace.h; main writes one to the file named by env
+// TRACE_FILE) and re-runs stage rounds from their checkpoints: the board
+// after the recorded moves of the rounds before, with the recorded random
+// state, limits and params. Without a round it lists them.
+//
+// A replayed round runs without the deadline of the original solve, so a
+// round that was cut short by it (marked in the list) makes other moves. So
+// can a long path round after the first, because the longest path cache
+// starts empty.
+//
+// g++ --std=c++11 -O2 -pthread replay.cc -o replay
+// TRACE_FILE=trace.bin ./main < board.txt > /dev/null
+// ./replay trace.bin
+// ./replay -round 7 trace.bin
+// ./replay -all trace.bin
+//
+// replay -self-test checks SearchEngine's split and resume instead.
+
+#include <iostream>
+#include <fstream>
+
+#include "pretty_printing.h"
+
+using namespace std;
+
+#include "sol.cc"
+
+
+// Long enough for any round without a deadline.
+const double REPLAY_TIME_LIMIT = 1000;
+
+
+struct RoundReplay {
+  double time;
+  vector<PackedMove> moves;
+  vector<int> candidate_scores;
+};
+
+
+RoundReplay replay_round(const SolveTrace &trace, int k, int pool_size) {
+  const TraceRound &round = trace.rounds[k];
+  int n = board_size(trace.board);
+  Board board = trace.board;
+  ApplyResult applied = apply_all<CHECKED>(board, trace.moves_before(k));
+  if (!applied.ok) {
+    cerr << "Corrupt trace: move " << applied.index << " before round " << k
+         << ": " << applied.error << endl;
+    exit(1);
+  }
+
+  SolverContext ctx;
+  TaskPool pool(pool_size);
+  ctx.pool = &pool;
+  ctx.limits = trace.limits;
+  ctx.params = trace.params;
+  ctx.set_deadline_from_now(REPLAY_TIME_LIMIT);
+  // Collects the candidate scores of pick_long_paths.
+  SolveTrace scratch(board, trace.seed, trace.preferred_parity,
+                     trace.tile_size, trace.limits, trace.params);
+  scratch.begin_round(round.stage, round.rand_state);
+  ctx.trace = &scratch;
+  ctx.srand(round.rand_state);
+
+  double start_time = get_time();
+  vector<Move> moves;
+  bool regions = use_regions(ctx, board);
+  if (round.stage == TRACE_SPARSIFY) {
+    moves = regions
+        ? region_sparsify_round(ctx, board, trace.preferred_parity)
+        : sparsify_round(ctx, board, trace.preferred_parity);
+  } else if (round.stage == TRACE_PATCH) {
+    moves = regions
+        ? region_patch_round(
+              ctx, board, trace.tile_size, trace.preferred_parity)
+        : divide_and_optimize(
+              ctx, board, trace.tile_size, trace.preferred_parity, 1);
+  } else {
+    auto paths = regions ? pick_region_long_paths(ctx, board)
+                         : pick_long_paths(ctx, board);
+    for (const auto &path : paths)
+      moves.insert(moves.end(), path.begin(), path.end());
+  }
+
+  RoundReplay result;
+  result.time = get_time() - start_time;
+  for (const auto &move : moves)
+    result.moves.push_back(pack_move(n, move));
+  result.candidate_scores = scratch.rounds.back().candidate_scores;
+  ctx.pop_deadline();
+  ctx.pool = nullptr;
+  return result;
+}
+
+
+// Index of the first difference of a and b, or -1 if they are equal.
+template<typename T>
+int first_difference(const vector<T> &a, const vector<T> &b) {
+  for (int i = 0; i < min(a.size(), b.size()); i++)
+    if (a[i] != b[i])
+      return i;
+  return a.size() == b.size() ? -1 : min(a.size(), b.size());
+}
+
+
+string round_name(const TraceRound &round) {
+  return string(TRACE_STAGE_NAMES[round.stage]) + " " + to_string(round.index);
+}
+
+
+// Prints how the replay of round k went; returns whether it made the same
+// moves.
+bool report_replay(const SolveTrace &trace, int k, int pool_size) {
+  const TraceRound &round = trace.rounds[k];
+  RoundReplay r = replay_round(trace, k, pool_size);
+  int diff = first_difference(round.moves, r.moves);
+  int candidates_diff = first_difference(round.candidate_scores, r.candidate_scores);
+  cout << k << " " << round_name(round) << ": "
+       << r.time << "s (recorded " << round.end_time - round.start_time << "s), "
+       << r.moves.size() << " moves";
+  if (diff < 0) {
+    cout << ", same";
+  } else {
+    cout << ", differs from move " << diff << " of " << round.moves.size();
+    if (round.deadline_hit)
+      cout << " (recorded round hit its deadline)";
+  }
+  if (candidates_diff >= 0)
+    cout << ", candidate scores differ from " << candidates_diff;
+  cout << endl;
+  return diff < 0;
+}
+
+
+void list_rounds(const SolveTrace &trace) {
+  cout << "# n = " << board_size(trace.board) << endl;
+  cout << "# seed = " << trace.seed << endl;
+  cout << "# preferred_parity = " << trace.preferred_parity << endl;
+  cout << "# tile_size = " << trace.tile_size << endl;
+  cout << "# time_limit = " << trace.limits.time_limit << endl;
+  vector<Move> moves = trace.moves_before(trace.rounds.size());
+  cout << "# moves = " << moves.size() << endl;
+  cout << "# score = " << moves_score(trace.board, moves) << endl;
+  for (int k = 0; k < trace.rounds.size(); k++) {
+    const auto &round = trace.rounds[k];
+    cout << k << " " << round_name(round)
+         << ": " << round.start_time << "s to " << round.end_time << "s, "
+         << round.moves.size() << " moves";
+    if (!round.candidate_scores.empty())
+      cout << ", " << round.candidate_scores.size() << " candidates, best "
+           << round.candidate_scores.front();
+    if (round.deadline_hit)
+      cout << ", hit deadline";
+    cout << endl;
+  }
+}
+
+
+int main(int argc, char **argv) {
+  int round = -1;
+  bool all = false;
+  int pool_size = max(1u, thread::hardware_concurrency());
+  string trace_file;
+
+  if (argc == 2 && string(argv[1]) == "-self-test")
+    return test_search_engine() ? 0 : 2;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "-round" && has_value) {
+      round = atoi(argv[++i]);
+    } else if (arg == "-all") {
+      all = true;
+    } else if (arg == "-pool" && has_value) {
+      pool_size = atoi(argv[++i]);
+    } else if (!arg.empty() && arg[0] != '-' && trace_file.empty()) {
+      trace_file = arg;
+    } else {
+      trace_file.clear();
+      break;
+    }
+  }
+  if (trace_file.empty()) {
+    cerr << "usage: replay [-round k | -all] [-pool threads] trace_file" << endl;
+    cerr << "       replay -self-test" << endl;
+    return 1;
+  }
+
+  ifstream in(trace_file, ios::binary);
+  SolveTrace trace;
+  if (!in || !trace.read(in)) {
+    cerr << "Can't read a trace from " << trace_file << endl;
+    return 1;
+  }
+
+  log_level = LOG_OFF;
+  if (getenv("LOG_LEVEL") != nullptr) {
+    int level;
+    if (parse_log_level(getenv("LOG_LEVEL"), level))
+      log_level = level;
+  }
+  test_bitpowersets();
+
+  if (all) {
+    int same = 0;
+    for (int k = 0; k < trace.rounds.size(); k++)
+      same += report_replay(trace, k, pool_size);
+    cout << "# same_rounds = " << same << endl;
+    cout << "# rounds = " << trace.rounds.size() << endl;
+    return same == trace.rounds.size() ? 0 : 2;
+  }
+  if (round >= 0) {
+    if (round >= trace.rounds.size()) {
+      cerr << "The trace has " << trace.rounds.size() << " rounds" << endl;
+      return 1;
+    }
+    return report_replay(trace, round, pool_size) ? 0 : 2;
+  }
+  list_rounds(trace);
+  return 0;
+}
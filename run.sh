@@ -1 +1 @@
-g++ --std=c++11 main.cc -Wall -Wno-sign-compare && java -jar tester.jar -exec "./sol.sh"
+g++ --std=c++11 main.cc -pthread -Wall -Wno-sign-compare && java -jar tester.jar -exec "./sol.sh"
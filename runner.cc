@@ -0,0 +1,193 @@
+// Local replacement for run_all.py: solves a corpus of boards (files in the
+// format main reads, e.g. inputs/ from grab_inputs.sh) in one process, one
+// board per thread at a time, checks and scores the moves with MoveValidator,
+// both as moves and as the text main would print, and writes one JSON object
+// per board as soon as it is done. Illegal move lists score -1.
+//
+// g++ --std=c++11 -O2 -pthread runner.cc -o runner
+// ./runner -budget full -out results.jsonl inputs/*.txt
+
+#include <iostream>
+#include <fstream>
+
+#include "pretty_printing.h"
+
+using namespace std;
+
+#include "sol.cc"
+#include "corpus.h"
+#include "embed.h"
+
+
+string json_string(const string &s) {
+  string result = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      result += '\\';
+    result += c;
+  }
+  return result + "\"";
+}
+
+
+template<typename T>
+string json_object(const map<string, T> &values) {
+  ostringstream out;
+  out << "{";
+  bool first = true;
+  for (const auto &kv : values) {
+    if (!first)
+      out << ", ";
+    first = false;
+    out << json_string(kv.first) << ": " << kv.second;
+  }
+  out << "}";
+  return out.str();
+}
+
+
+// File name without directories and extension, as a JSON number if it is
+// one (grab_inputs.sh names boards by seed).
+string seed_of(const string &filename) {
+  string name = filename.substr(filename.find_last_of('/') + 1);
+  name = name.substr(0, name.find('.'));
+  bool numeric = !name.empty() &&
+      all_of(name.begin(), name.end(), [](char c) { return isdigit(c); });
+  return numeric ? name : json_string(name);
+}
+
+
+struct BoardResult {
+  int n;
+  long long score;
+  string error;
+  double time;
+  SolverContext ctx;
+};
+
+
+string to_json(const CorpusBoard &board, const BoardResult &r) {
+  ostringstream out;
+  out << setprecision(6);
+  out << "{\"seed\": " << seed_of(board.filename)
+      << ", \"file\": " << json_string(board.filename)
+      << ", \"n\": " << r.n
+      << ", \"score\": " << r.score;
+  if (!r.error.empty())
+    out << ", \"error\": " << json_string(r.error);
+  out << ", \"time\": " << r.time
+      << ", \"stage_rounds\": " << json_object(r.ctx.stage_budget.rounds)
+      << ", \"stage_times\": " << json_object(r.ctx.stage_budget.times)
+      << ", \"stage_gains\": " << json_object(r.ctx.stage_budget.gains)
+      << ", \"timers\": " << json_object(r.ctx.timers)
+      << "}";
+  return out.str();
+}
+
+
+int main(int argc, char **argv) {
+  PegJumping solver;
+  solver.portfolio_size = 1;
+  solver.pool_size = 1;
+  int num_threads = max(1u, thread::hardware_concurrency());
+  string out_file = "results.jsonl";
+  vector<string> board_files;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "-budget" && has_value) {
+      double seconds;
+      if (!parse_budget(argv[++i], seconds)) {
+        cerr << "Bad budget " << argv[i] << endl;
+        return 1;
+      }
+      solver.limits = limits_for_budget(seconds);
+    } else if (arg == "-threads" && has_value) {
+      num_threads = atoi(argv[++i]);
+    } else if (arg == "-pool" && has_value) {
+      solver.pool_size = atoi(argv[++i]);
+    } else if (arg == "-params" && has_value) {
+      if (!solver.params.load(argv[++i]))
+        return 1;
+    } else if (arg == "-out" && has_value) {
+      out_file = argv[++i];
+    } else if (!arg.empty() && arg[0] == '-') {
+      cerr << "Unknown option " << arg << endl;
+      return 1;
+    } else {
+      board_files.push_back(arg);
+    }
+  }
+  if (board_files.empty()) {
+    cerr << "usage: runner [-budget tier_or_seconds] [-threads k] "
+         << "[-pool k] [-params params.txt] [-out results.jsonl] "
+         << "board_files..." << endl;
+    return 1;
+  }
+
+  vector<CorpusBoard> corpus;
+  for (const auto &f : board_files)
+    corpus.push_back(read_board(f));
+
+  ofstream out(out_file);
+  if (!out) {
+    cerr << "Can't write " << out_file << endl;
+    return 1;
+  }
+
+  // Stats of concurrent solves would interleave.
+  log_level = LOG_OFF;
+
+  double start_time = get_time();
+  vector<long long> scores(corpus.size());
+  mutex out_mutex;
+  atomic<int> next(0);
+  auto worker = [&]() {
+    while (true) {
+      int i = next++;
+      if (i >= corpus.size())
+        break;
+      Board board = parse_board(corpus[i].peg_values, corpus[i].rows);
+      BoardResult r;
+      r.n = corpus[i].rows.size();
+      PegJumping board_solver = solver;
+      double board_start = get_time();
+      vector<Move> moves = board_solver.solve(r.ctx, board);
+      r.time = get_time() - board_start;
+      MoveValidator validator(board);
+      Validation v = validator.replay(moves);
+      string text;
+      append_moves_text(r.n, moves, text);
+      Validation text_v = validator.replay_text(text);
+      r.score = v.ok ? v.score : -1;
+      if (!v.ok) {
+        r.error = v.error;
+      } else if (!text_v.ok || text_v.score != v.score) {
+        r.score = -1;
+        r.error = "output text: " +
+            (text_v.ok ? "score " + to_string(text_v.score) : text_v.error);
+      }
+      scores[i] = r.score;
+
+      string line = to_json(corpus[i], r);
+      lock_guard<mutex> lock(out_mutex);
+      out << line << endl;
+    }
+  };
+  vector<thread> threads;
+  for (int k = 0; k < num_threads; k++)
+    threads.emplace_back(worker);
+  for (auto &t : threads)
+    t.join();
+
+  int illegal = count(scores.begin(), scores.end(), -1);
+  long long total = 0;
+  for (long long s : scores)
+    total += max(s, 0LL);
+  cout << "# boards = " << corpus.size() << endl;
+  cout << "# illegal = " << illegal << endl;
+  cout << "# mean_score = " << 1.0 * total / corpus.size() << endl;
+  cout << "# wall_time = " << get_time() - start_time << endl;
+  return illegal > 0 ? 2 : 0;
+}
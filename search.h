@@ -0,0 +1,214 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+
+// Depth first search with an explicit stack, so it can stop after any node,
+// continue later, and give untried subtrees away to another engine.
+//
+// Problem is the mutable search state and provides
+//   typedef ... Step;  // an edge of the search tree
+//   bool visit();  // at every node, false prunes its subtree
+//   void expand(vector<Step> &steps);  // children of the current node, in
+//                                      // search order
+//   void apply(const Step &step);
+//   void undo(const Step &step);
+// expand() is called right after visit(), and the engine restores the state
+// before every sibling, so it is the same as trying the moves recursively.
+template<typename Problem>
+class SearchEngine {
+public:
+  typedef typename Problem::Step Step;
+
+  // Unexplored part of a search tree: the steps from the root to some node,
+  // and some of that node's children.
+  struct Subtree {
+    vector<Step> prefix;
+    vector<Step> steps;
+  };
+
+  long long nodes = 0;
+
+  // Starts at the current state of the problem.
+  explicit SearchEngine(Problem &problem) : problem(problem) {}
+
+  // Searches the subtree given away by split() of another engine, whose
+  // problem was in the same state as this one. Nodes on the prefix are not
+  // visited again.
+  SearchEngine(Problem &problem, const Subtree &subtree)
+      : problem(problem), prefix(subtree.prefix), started(true) {
+    for (const auto &step : prefix)
+      problem.apply(step);
+    stack.push_back(Frame{subtree.steps, 0});
+  }
+
+  bool done() const {
+    return started && stack.empty();
+  }
+
+  // Visits at most max_nodes more nodes. Returns whether the search is
+  // complete; then the problem is back in its initial state. Otherwise it is
+  // in the state of the last visited node, until run() or abandon().
+  bool run(long long max_nodes) {
+    long long limit = nodes + max_nodes;
+    if (!started) {
+      if (max_nodes <= 0)
+        return false;
+      started = true;
+      enter();
+    }
+    while (!stack.empty()) {
+      Frame &top = stack.back();
+      if (top.next == top.steps.size()) {
+        stack.pop_back();
+        if (!stack.empty())
+          problem.undo(stack.back().steps[stack.back().next - 1]);
+        continue;
+      }
+      if (nodes >= limit)
+        return false;
+      Step step = top.steps[top.next++];
+      problem.apply(step);
+      enter();
+    }
+    for (int i = prefix.size() - 1; i >= 0; i--)
+      problem.undo(prefix[i]);
+    prefix.clear();
+    return true;
+  }
+
+  // Gives up on the rest of the search and puts the problem back into its
+  // initial state.
+  void abandon() {
+    while (!stack.empty()) {
+      stack.pop_back();
+      if (!stack.empty())
+        problem.undo(stack.back().steps[stack.back().next - 1]);
+    }
+    for (int i = prefix.size() - 1; i >= 0; i--)
+      problem.undo(prefix[i]);
+    prefix.clear();
+    started = true;
+  }
+
+  // Moves the later half of the untried children of the shallowest node
+  // that has any into subtree. Returns false if there are none.
+  bool split(Subtree &subtree) {
+    subtree.prefix = prefix;
+    for (auto &frame : stack) {
+      int untried = frame.steps.size() - frame.next;
+      if (untried > 0) {
+        int keep = frame.next + untried / 2;
+        subtree.steps.assign(frame.steps.begin() + keep, frame.steps.end());
+        frame.steps.erase(frame.steps.begin() + keep, frame.steps.end());
+        return true;
+      }
+      if (frame.next == 0)
+        break;
+      subtree.prefix.push_back(frame.steps[frame.next - 1]);
+    }
+    return false;
+  }
+
+private:
+  struct Frame {
+    vector<Step> steps;
+    int next;
+  };
+
+  Problem &problem;
+  vector<Step> prefix;
+  vector<Frame> stack;
+  bool started = false;
+
+  void enter() {
+    nodes++;
+    stack.push_back(Frame{{}, 0});
+    if (problem.visit())
+      problem.expand(stack.back().steps);
+  }
+};
+
+
+// Fixed pseudo-random tree for test_search_engine: a node has up to 4
+// children and a value, both given by a hash of its path.
+struct TestSearchTree {
+  typedef int Step;
+  vector<int> path;
+  int best = -1;  // value of the best visited node
+
+  unsigned hash() const {
+    unsigned h = 2166136261u;
+    for (int step : path)
+      h = (h ^ (step + 1)) * 16777619u;
+    return h;
+  }
+
+  bool visit() {
+    best = max(best, int(hash() >> 8 & 0xffff));
+    return true;
+  }
+
+  void expand(vector<int> &steps) {
+    if (path.size() < 8)
+      for (int k = 0; k < int(hash() % 5); k++)
+        steps.push_back(k);
+  }
+
+  void apply(int step) {
+    path.push_back(step);
+  }
+
+  void undo(int step) {
+    assert(!path.empty() && path.back() == step);
+    path.pop_back();
+  }
+};
+
+// Stops a search at some node, splits it twice (the second time in the
+// engine that resumed the first part given away), and checks that the three
+// engines together visit the same nodes as one uninterrupted run. Reports
+// failed checks to stderr rather than asserting, so that it works in NDEBUG
+// builds; replay -self-test runs it.
+bool test_search_engine() {
+  bool ok = true;
+  auto check = [&ok](bool condition, const string &what) {
+    if (!condition) {
+      cerr << "test_search_engine: " << what << endl;
+      ok = false;
+    }
+  };
+
+  TestSearchTree whole;
+  SearchEngine<TestSearchTree> whole_engine(whole);
+  check(whole_engine.run(1LL << 40), "whole run incomplete");
+  check(whole.path.empty(), "whole run left steps applied");
+  check(whole_engine.nodes > 100, "tree too small");
+
+  for (long long stop : {1LL, 7LL, 50LL, whole_engine.nodes / 2}) {
+    string at = " after " + to_string(stop) + " nodes";
+    TestSearchTree a, b, c;
+    SearchEngine<TestSearchTree> engine_a(a);
+    check(!engine_a.run(stop), "run complete" + at);
+    SearchEngine<TestSearchTree>::Subtree given_b;
+    check(engine_a.split(given_b), "nothing to split" + at);
+
+    SearchEngine<TestSearchTree> engine_b(b, given_b);
+    SearchEngine<TestSearchTree>::Subtree given_c;
+    if (!engine_b.run(3))
+      engine_b.split(given_c);
+    SearchEngine<TestSearchTree> engine_c(c, given_c);
+
+    check(engine_a.run(1LL << 40) && engine_b.run(1LL << 40) &&
+          engine_c.run(1LL << 40), "resumed runs incomplete" + at);
+    check(a.path.empty() && b.path.empty() && c.path.empty(),
+          "resumed runs left steps applied" + at);
+    check(engine_a.nodes + engine_b.nodes + engine_c.nodes ==
+          whole_engine.nodes, "node counts differ" + at);
+    check(max(a.best, max(b.best, c.best)) == whole.best,
+          "best values differ" + at);
+  }
+  return ok;
+}
+
+
+#endif
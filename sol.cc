@@ -2,23 +2,35 @@
 
 #ifndef SUBMISSION
 #define USE_TIME_IT
+#define LP_TELEMETRY
+#else
+#define MAX_LOG_LEVEL LOG_STATS
 #endif
 
 #include <unistd.h>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
 #include "common.h"
+#include "bitboard.h"
 #include "sparsify.h"
 #include "bridges.h"
 #include "patch.h"
+#include "trace.h"
 
 
-const float TIME_LIMIT = 9.0;
 
+// Candidates are (score, path) pairs.
+typedef vector<pair<int, vector<int>>> PathCandidates;
 
-vector<Move> pick_long_path(const Board &board, int i_parity, int j_parity) {
+
+
+Graph build_parity_graph(const Board &board, int i_parity, int j_parity) {
   int n = board_size(board);
   Graph graph;
+  int parity_class = i_parity * 2 + j_parity;
   for (int pos = 0; pos < n * n; pos++) {
-    if (pos % n % 2 == j_parity && pos / n % 2 == i_parity) {
+    if (board.parity_class(pos) == parity_class) {
       if (board[pos] == EMPTY) {
         for (auto e : collect_edges(n, board, pos)) {
           add_edge(graph, e);
@@ -26,219 +38,828 @@ vector<Move> pick_long_path(const Board &board, int i_parity, int j_parity) {
       }
     }
   }
+  return graph;
+}
 
-  vector<int> best;
-  int best_score = -1;
+
+// Best path from every start that is worth trying, as (score, path) pairs.
+// Starts of all four parity classes are tried in the order of their
+// component bound, and the ones that can't make it into the batch are cut.
+PathCandidates collect_long_paths(SolverContext &ctx, const Board &board) {
+  int n = board_size(board);
+
+  Graph graphs[2][2];
+  vector<ComponentBounds> bounds;
+  for (int i_parity = 0; i_parity < 2; i_parity++)
+    for (int j_parity = 0; j_parity < 2; j_parity++) {
+      graphs[i_parity][j_parity] = build_parity_graph(board, i_parity, j_parity);
+      bounds.emplace_back(graphs[i_parity][j_parity], board);
+    }
 
   vector<int> poss(n*n);
   iota(poss.begin(), poss.end(), 0);
-  shuffle(poss.begin(), poss.end(), std::default_random_engine(42));
+  shuffle(poss.begin(), poss.end(), default_random_engine(ctx.rand()));
 
+  // (bound, pos)
+  vector<pair<long long, int>> starts;
   for (int pos : poss) {
-    if (pos % n % 2 == j_parity && pos / n % 2 == i_parity) {
-      if (best_score > 0 && check_deadline()) {
-        cerr << "shit" << endl;
-        break;
-      }
-      // if (rand() % 13 == 0)
-      //   cerr << 100 * pos / (n * n) << "%" << endl;
-
-      if (board[pos] == EMPTY) continue;
-
-      auto es = collect_edges(n, board, pos);
-      if (!es.empty()) {
-        Graph g = graph;
-        for (auto e : es)
-          add_edge(g, e);
-
-        vector<int> path = longest_path_from(g, pos, board);
-        int score = path_score(board, path);
-        if (score > best_score) {
-          best = path;
-          best_score = score;
-        }
-      }
+    if (board[pos] == EMPTY) continue;
+    auto es = collect_edges(n, board, pos);
+    if (es.empty()) continue;
+    starts.emplace_back(
+        bounds[board.parity_class(pos)].start_bound(board, es), pos);
+  }
+  stable_sort(starts.begin(), starts.end(),
+      [](const pair<long long, int> &a, const pair<long long, int> &b) {
+    return a.first > b.first;
+  });
+
+  PathCandidates candidates;
+  int best_score = -1;
+  int num_cut = 0;
+
+  for (const auto &start : starts) {
+    int pos = start.second;
+    if (start.first < ctx.params.min_batch_score_ratio * best_score) {
+      // The rest have even smaller bounds.
+      num_cut = starts.size() - (&start - &starts.front());
+      break;
     }
+    if (best_score > 0 && ctx.check_deadline()) {
+      LOG(LOG_INFO) << "shit";
+      break;
+    }
+
+    Graph g = graphs[pos / n % 2][pos % n % 2];
+    for (auto e : collect_edges(n, board, pos))
+      add_edge(g, e);
+
+    vector<int> path = longest_path_from(ctx, g, pos, board);
+    int score = path_score(board, path);
+    best_score = max(best_score, score);
+    if (score > 0)
+      candidates.emplace_back(score, path);
   }
-  //cerr << best << endl;
-  if (best.empty())
-    return {};
 
-  vector<Move> result;
-  for (int i = 1; i < best.size(); i++)
-    result.emplace_back(best[i - 1], (best[i] - best[i - 1]) / 2);
-  return result;
+  if (!starts.empty())
+    ctx.start_cut_ratios.push_back(1.0 * num_cut / starts.size());
+  return candidates;
 }
 
 
-vector<Move> pick_long_path(const Board &board) {
-  add_work(1e-6 * pow(board_size(board), 3));
-  vector<Move> best_path;
-  int best_score = -1;
+// Potential of the board for StageBudget: the largest component bound
+// (see ComponentBounds) over all parity classes.
+double long_path_potential(const Board &board) {
+  double result = 0;
   for (int i_parity = 0; i_parity < 2; i_parity++)
     for (int j_parity = 0; j_parity < 2; j_parity++) {
-      auto path = pick_long_path(board, i_parity, j_parity);
-      int score = path_score(board, path);
-      //cerr << "score " << score << endl;
-      if (score > best_score) {
-        if (best_score > 5000)
-          cerr << "# improvement = " << 1.0 * score / best_score << endl;
-        best_score = score;
-        best_path = path;
-      }
+      ComponentBounds cb(build_parity_graph(board, i_parity, j_parity), board);
+      for (int c = 0; c < cb.edge_counts.size(); c++)
+        result = max(result, 1.0 * cb.edge_counts[c] * cb.middle_sums[c]);
     }
-  return best_path;
+  return result;
 }
 
 
-class PegJumping {
-public:
-  int n;
+// Returns several paths ranked by score that can be applied in any order,
+// because no two of them share a cell (see path_footprint).
+vector<vector<Move>> pick_long_paths(SolverContext &ctx, const Board &board) {
+  #ifdef LP_TELEMETRY
+  double start_time = get_time();
+  #endif
+  PathCandidates candidates = collect_long_paths(ctx, board);
+  int best_score = -1;
+  for (const auto &candidate : candidates)
+    best_score = max(best_score, candidate.first);
+
+  stable_sort(candidates.begin(), candidates.end(),
+      [](const pair<int, vector<int>> &a, const pair<int, vector<int>> &b) {
+    return a.first > b.first;
+  });
+
+  vector<vector<Move>> result;
+  vector<bool> used(board.size());
+  for (const auto &candidate : candidates) {
+    if (candidate.first < ctx.params.min_batch_score_ratio * best_score)
+      break;
+    const auto &path = candidate.second;
+    auto footprint = path_footprint(path);
+    bool interferes = false;
+    for (int pos : footprint)
+      interferes = interferes || used[pos];
+    if (interferes)
+      continue;
+    // A path also changes which jumps are possible within two cells of it,
+    // so paths that come close could have grown if applied after it.
+    int n = board_size(board);
+    for (int pos : footprint)
+      for (int di = -2; di <= 2; di++)
+        for (int dj = -2; dj <= 2; dj++) {
+          int i = pos / n + di;
+          int j = pos % n + dj;
+          if (i >= 0 && i < n && j >= 0 && j < n)
+            used[i * n + j] = true;
+        }
 
-  vector<string> getMoves(vector<int> peg_values, vector<string> board_) {
-    auto start_time = get_time();
-    set_deadline_from_now(TIME_LIMIT);
+    result.push_back(path_to_moves(path));
+  }
 
-    //benchmark_timers(cerr);
+  if (ctx.trace) {
+    vector<int> scores;
+    for (const auto &candidate : candidates)
+      scores.push_back(candidate.first);
+    ctx.trace->candidates(scores);
+  }
 
-    srand(42);
-    vector<Move> final_moves;
-    { TimeIt time_it("total");
-
-    n = board_.size();
-    cerr << "# n = " << n << endl;
-
-    Board board;
-    int non_empty = 0;
-    int min_peg_value = 10;
-    int max_peg_value = 0;
-    for (auto row : board_) {
-      assert(row.size() == n);
-      for (auto c : row) {
-        if (c == '.')
-          board.push_back(EMPTY);
-        else {
-          board.push_back(peg_values.at(c - '0'));
-          assert(board.back() != EMPTY);
-          min_peg_value = min(min_peg_value, board.back());
-          max_peg_value = max(max_peg_value, board.back());
-          non_empty++;
-        }
-      }
-    }
-    cerr << "# density = " << 1.0 * non_empty / board.size() << endl;
-
-    cerr << board_to_string(board) << endl;
-
-    int even_pegs = 0;
-    int odd_pegs = 0;
-    int even_value = 0;
-    int odd_value = 0;
-    for (int pos = 0; pos < n*n; pos++)
-      if (board[pos] != EMPTY) {
-        if ((pos / n + pos % n) % 2 == 0) {
-          even_pegs++;
-          even_value += board[pos];
-        } else {
-          odd_pegs++;
-          odd_value += board[pos];
-        }
-      }
+  #ifdef LP_TELEMETRY
+  ctx.pick_long_paths_stats.emplace_back(
+      candidates.size(), result.size(), best_score,
+      get_time() - start_time);
+  #endif
+  return result;
+}
 
-    cerr << "even value: " << even_pegs*even_value << endl;
-    cerr << "odd value: " << odd_pegs*odd_value << endl;
 
-    // TODO: I suspect it actually reduces score by 5%. Investigate.
-    int preferred_parity = 0;
-    if (n % 2 == 0 and odd_pegs*odd_value > even_pegs*even_value)
-      preferred_parity = 1;
+// One variant of the solver pipeline. Portfolio mode runs several of them
+// concurrently and keeps the best result.
+struct PipelineConfig {
+  int index;  // only variant 0 prints its stats
+  unsigned int seed;
+  int preferred_parity;
+  int tile_size;
+};
 
-    cerr << "# preferred_parity = " << preferred_parity << endl;
 
-    for (int i = 0; i < 2; i++) {
-      TimeIt t("sparsify");
-      // horizontally
-      for (auto move : full_sparsify(board, preferred_parity)) {
-        final_moves.push_back(move);
-        move.apply(board);
-      }
+// One round of sparsification: horizontally, then vertically on the result.
+vector<Move> sparsify_round(
+    SolverContext &ctx, Board board, int preferred_parity) {
+  int n = board_size(board);
+  vector<Move> moves = full_sparsify(ctx, board, preferred_parity);
+  apply_all(board, moves);
+  for (auto move : transpose_moves(
+           n, full_sparsify(ctx, transpose_board(board), preferred_parity)))
+    moves.push_back(move);
+  return moves;
+}
+
+
+// Applies the moves of a stage round to board and appends them to
+// final_moves.
+void apply_round_moves(
+    SolverContext &ctx, const vector<Move> &moves,
+    Board &board, vector<Move> &final_moves) {
+  apply_all(board, moves);
+  final_moves.insert(final_moves.end(), moves.begin(), moves.end());
+  if (ctx.trace)
+    for (const auto &move : moves)
+      ctx.trace->move(move);
+}
+
+
+// Large boards (params.region_board_min and up) are solved region by region:
+// every stage round tiles the board with square regions and solves them
+// concurrently, each in a context of its own. Regions don't overlap, so
+// their moves touch different cells and can be applied in any order, and
+// the searches of a round never see more than one region. The tiling changes
+// from round to round so that the seams move.
+bool use_regions(const SolverContext &ctx, const Board &board) {
+  return board_size(board) >= ctx.params.region_board_min;
+}
+
+
+// k or k + 1 regions per side (k is about n / region_size), at random even
+// offsets in what is left over, so that parities stay the same.
+vector<Patcher> region_tiling(SolverContext &ctx, const Board &board) {
+  int n = board_size(board);
+  int k = max(1, n / ctx.params.region_size) + ctx.rand() % 2;
+  int size = n / k / 2 * 2;
+  int base_i = ctx.rand() % ((n - k * size) / 2 + 1) * 2;
+  int base_j = ctx.rand() % ((n - k * size) / 2 + 1) * 2;
+  // Regions not started by the deadline are left for the next round, and
+  // shouldn't always be the same ones.
+  vector<int> order(k * k);
+  iota(order.begin(), order.end(), 0);
+  shuffle(order.begin(), order.end(), default_random_engine(ctx.rand()));
+  vector<Patcher> regions;
+  for (int r : order)
+    regions.emplace_back(board, base_i + r / k * size, base_j + r % k * size, size);
+  return regions;
+}
+
+
+// Runs solve on every region, concurrently, each in a context with the
+// deadline, limits and params of ctx and a random seed of its own, and adds
+// the work they count to ctx. The regions run their own loops inline.
+template<typename Result>
+vector<Result> solve_regions(
+    SolverContext &ctx, const vector<Patcher> &regions,
+    const function<Result(SolverContext &, const Board &)> &solve) {
+  vector<unsigned int> seeds;
+  for (int k = 0; k < regions.size(); k++)
+    seeds.push_back(ctx.rand());
+  double deadline = ctx.deadlines.back();
+  vector<Result> results(regions.size());
+  vector<vector<double>> work(regions.size());
+  ctx.parallel_for(regions.size(), [&](int k, int slot) {
+    SolverContext region_ctx;
+    region_ctx.push_deadline(deadline);
+    region_ctx.limits = ctx.limits;
+    region_ctx.params = ctx.params;
+    region_ctx.cancelled = ctx.cancelled;
+    region_ctx.shared_lp_cache = ctx.shared_lp_cache;
+    region_ctx.srand(seeds[k]);
+    results[k] = solve(region_ctx, regions[k].get());
+    region_ctx.pop_deadline();
+    const double *units = region_ctx.cost_model.units;
+    work[k].assign(units, units + NUM_WORK_KINDS);
+  });
+  for (const auto &units : work)
+    for (int kind = 0; kind < units.size(); kind++)
+      ctx.add_work(WorkKind(kind), units[kind]);
+  return results;
+}
+
+
+vector<Move> region_sparsify_round(
+    SolverContext &ctx, const Board &board, int preferred_parity) {
+  auto regions = region_tiling(ctx, board);
+  auto results = solve_regions<vector<Move>>(ctx, regions,
+      [preferred_parity](SolverContext &region_ctx, const Board &region) {
+    return sparsify_round(region_ctx, region, preferred_parity);
+  });
+  vector<Move> moves;
+  for (int k = 0; k < regions.size(); k++)
+    for (const auto &move : regions[k].translate_moves(results[k]))
+      moves.push_back(move);
+  return moves;
+}
+
+
+vector<Move> region_patch_round(
+    SolverContext &ctx, const Board &board,
+    int tile_size, int preferred_parity) {
+  auto regions = region_tiling(ctx, board);
+  auto results = solve_regions<vector<Move>>(ctx, regions,
+      [tile_size, preferred_parity](SolverContext &region_ctx, const Board &region) {
+    return divide_and_optimize(region_ctx, region, tile_size, preferred_parity, 1);
+  });
+  vector<Move> moves;
+  for (int k = 0; k < regions.size(); k++)
+    for (const auto &move : regions[k].translate_moves(results[k]))
+      moves.push_back(move);
+  return moves;
+}
 
-      // vertically
-      for (auto move : transpose_moves(n, full_sparsify(transpose_board(board), preferred_parity))) {
-        final_moves.push_back(move);
-        move.apply(board);
-      }
-    }
 
-    cerr << board_to_string(board) << endl;
+// Longest path the peg at pos can go on with, within a window of about
+// params.region_size around it.
+vector<Move> continue_path(SolverContext &ctx, const Board &board, int pos) {
+  int n = board_size(board);
+  int size = min(n, ctx.params.region_size);
+  int i0 = max(0, min(n - size, pos / n - size / 2));
+  int j0 = max(0, min(n - size, pos % n - size / 2));
+  Patcher window(board, i0, j0, size);
+  Board local = window.get();
+  int from = (pos / n - i0) * size + pos % n - j0;
+  auto es = collect_edges(size, local, from);
+  if (es.empty())
+    return {};
+  Graph g = build_parity_graph(local, from / size % 2, from % size % 2);
+  for (auto e : es)
+    add_edge(g, e);
+  vector<int> path = longest_path_from(ctx, g, from, local);
+  return window.translate_moves(path_to_moves(path));
+}
 
-    cerr << show_edges(board, 0, preferred_parity) << endl;
 
-    add_subdeadline(0.1);
-    for (auto move : divide_and_optimize(board, 8, preferred_parity)) {
-      final_moves.push_back(move);
-      move.apply(board);
+// pick_long_paths of every region, best first, where paths that end at the
+// edge of their region are continued across it by continue_path, because
+// one path scores more than its two parts would. Paths that touch cells
+// changed by a continuation are left for the next round.
+vector<vector<Move>> pick_region_long_paths(
+    SolverContext &ctx, const Board &board) {
+  int n = board_size(board);
+  auto regions = region_tiling(ctx, board);
+  auto results = solve_regions<vector<vector<Move>>>(ctx, regions,
+      [](SolverContext &region_ctx, const Board &region) {
+    return pick_long_paths(region_ctx, region);
+  });
+
+  // (score, region, moves)
+  vector<tuple<int, int, vector<Move>>> paths;
+  for (int k = 0; k < regions.size(); k++)
+    for (const auto &path : results[k]) {
+      auto moves = regions[k].translate_moves(path);
+      paths.emplace_back(path_score(board, moves), k, moves);
+    }
+  stable_sort(paths.begin(), paths.end(),
+      [](const tuple<int, int, vector<Move>> &a,
+         const tuple<int, int, vector<Move>> &b) {
+    return get<0>(a) > get<0>(b);
+  });
+  if (ctx.trace) {
+    vector<int> scores;
+    for (const auto &p : paths)
+      scores.push_back(get<0>(p));
+    ctx.trace->candidates(scores);
+  }
+
+  Board current = board;
+  vector<bool> changed(n * n);
+  vector<vector<Move>> result;
+  for (auto &p : paths) {
+    vector<Move> &moves = get<2>(p);
+    bool blocked = false;
+    for (const auto &move : moves)
+      for (int c = 0; c <= 2; c++)
+        blocked = blocked || changed[move.start + c * move.delta];
+    if (blocked)
+      continue;
+    apply_all(current, moves);
+
+    const Patcher &region = regions[get<1>(p)];
+    int end = moves.back().start + 2 * moves.back().delta;
+    int i = end / n - region.i0;
+    int j = end % n - region.j0;
+    // A jump from there lands outside the region.
+    if (min(i, j) <= 1 || max(i, j) >= region.size - 2) {
+      for (auto move : continue_path(ctx, current, end)) {
+        for (int c = 0; c <= 2; c++)
+          changed[move.start + c * move.delta] = true;
+        move.apply(current);
+        moves.push_back(move);
+      }
     }
-    deadlines.pop_back();
-    if (deadlines.size() != 1) cerr << "Deadlines: " << deadlines << endl;
-    assert(deadlines.size() == 1);
+    result.push_back(moves);
+  }
+  return result;
+}
 
-    cerr << show_edges(board, 0, preferred_parity) << endl;
 
+// long_path_potential, by region on large boards: the largest over the
+// regions of a fixed tiling, so that no whole board graph is ever built.
+double board_potential(SolverContext &ctx, const Board &board) {
+  if (!use_regions(ctx, board))
+    return long_path_potential(board);
+  int n = board_size(board);
+  int k = max(1, n / ctx.params.region_size);
+  int size = n / k;
+  double result = 0;
+  for (int i = 0; i < k; i++)
+    for (int j = 0; j < k; j++)
+      result = max(result, long_path_potential(
+          Patcher(board, i * size, j * size, size).get()));
+  return result;
+}
 
-    vector<int> path_scores;
-    int i = 0;
-    while (true) {
-      add_subdeadline(0.8);
 
-      auto long_path = pick_long_path(board);
-      deadlines.pop_back();
+// Lets whoever started the solve see the moves made so far, if anyone asked.
+void publish_progress(SolverContext &ctx, const vector<Move> &moves) {
+  if (ctx.best_moves)
+    ctx.best_moves->offer(moves);
+}
 
-      if (long_path.empty()) break;
+
+// Board should be fresh (no moves made). Deadline is taken from deadlines.
+vector<Move> run_pipeline(
+    SolverContext &ctx, Board board, const PipelineConfig &config) {
+  int n = board_size(board);
+  int preferred_parity = config.preferred_parity;
+  ctx.srand(config.seed);
+  vector<Move> final_moves;
+  if (ctx.trace)
+    *ctx.trace = SolveTrace(board, config.seed, preferred_parity,
+                            config.tile_size, ctx.limits, ctx.params);
+
+  bool regions = use_regions(ctx, board);
+  double potential = board_potential(ctx, board);
+  if (config.index == 0)
+    LOG_STAT("initial_potential", potential);
+
+  // Rounds beyond the minimum are given by stage_budget. Sparsification can't
+  // be interrupted, so no round starts unless it is predicted to fit.
+  const SolveLimits &limits = ctx.limits;
+  for (int i = 0; i < limits.max_sparsify_rounds; i++) {
+    if (ctx.is_cancelled() ||
+        ctx.cost_model.predict_round("sparsify") > ctx.time_left() ||
+        !ctx.stage_budget.worth_another_round(
+            "sparsify", potential, ctx.deadlines.back() - ctx.get_time(),
+            limits.min_sparsify_rounds))
+      break;
+    double round_start = ctx.get_time();
+    auto mark = ctx.cost_model.mark();
+    ctx.add_work(ROUND_CELLS, n * n);
+    TimeIt t(ctx, "sparsify");
+    if (ctx.trace)
+      ctx.trace->begin_round(TRACE_SPARSIFY, ctx.rand_state);
+    // By region, a round can stop between regions, so it gets a deadline.
+    if (regions)
+      ctx.add_subdeadline(ctx.params.region_sparsify_share);
+    apply_round_moves(
+        ctx, regions ? region_sparsify_round(ctx, board, preferred_parity)
+                     : sparsify_round(ctx, board, preferred_parity),
+        board, final_moves);
+    bool deadline_hit = ctx.check_deadline();
+    if (regions)
+      ctx.pop_deadline();
+    if (ctx.trace)
+      ctx.trace->end_round(deadline_hit);
+
+    double new_potential = board_potential(ctx, board);
+    ctx.stage_budget.add_round(
+        "sparsify", ctx.get_time() - round_start, new_potential - potential);
+    ctx.cost_model.observe("sparsify", mark);
+    potential = new_potential;
+    publish_progress(ctx, final_moves);
+  }
+
+  LOG(LOG_DEBUG) << board_to_string(board);
+  LOG(LOG_DEBUG) << show_edges(board, 0, preferred_parity);
+
+  ctx.add_subdeadline(ctx.params.patch_share);
+  for (int i = 0; i < limits.max_patch_rounds; i++) {
+    if (ctx.check_deadline() ||
+        ctx.cost_model.predict_round("patch") > ctx.time_left() ||
+        !ctx.stage_budget.worth_another_round(
+            "patch", potential, ctx.deadlines.front() - ctx.get_time(),
+            limits.min_patch_rounds))
+      break;
+    double round_start = ctx.get_time();
+    auto mark = ctx.cost_model.mark();
+    ctx.add_work(ROUND_CELLS, n * n);
+    if (ctx.trace)
+      ctx.trace->begin_round(TRACE_PATCH, ctx.rand_state);
+    apply_round_moves(
+        ctx, regions ? region_patch_round(ctx, board, config.tile_size, preferred_parity)
+                     : divide_and_optimize(ctx, board, config.tile_size, preferred_parity, 1),
+        board, final_moves);
+    if (ctx.trace)
+      ctx.trace->end_round(ctx.check_deadline());
+    double new_potential = board_potential(ctx, board);
+    ctx.stage_budget.add_round(
+        "patch", ctx.get_time() - round_start, new_potential - potential);
+    ctx.cost_model.observe("patch", mark);
+    potential = new_potential;
+    publish_progress(ctx, final_moves);
+  }
+  ctx.pop_deadline();
+  if (ctx.deadlines.size() != 1) cerr << "Deadlines: " << ctx.deadlines << endl;
+  assert(ctx.deadlines.size() == 1);
+
+  LOG(LOG_DEBUG) << show_edges(board, 0, preferred_parity);
+
+
+  vector<int> path_scores;
+  int i = 0;
+  while (true) {
+    ctx.add_subdeadline(ctx.params.long_path_share);
+
+    double round_start = ctx.get_time();
+    auto mark = ctx.cost_model.mark();
+    ctx.add_work(ROUND_CELLS, n * n);
+    if (ctx.trace)
+      ctx.trace->begin_round(TRACE_LONG_PATH, ctx.rand_state);
+    auto long_paths = regions ? pick_region_long_paths(ctx, board)
+                              : pick_long_paths(ctx, board);
+    bool deadline_hit = ctx.check_deadline();
+    ctx.pop_deadline();
+    ctx.cost_model.observe("long_path", mark);
+
+    if (long_paths.empty()) {
+      if (ctx.trace)
+        ctx.trace->end_round(deadline_hit);
+      break;
+    }
+    double gain = 0;
+    for (const auto &long_path : long_paths) {
       //cerr << "# long_path = " << long_path.size() << endl;
       int score = path_score(board, long_path);
       path_scores.push_back(score);
+      gain += score;
 
-      for (auto move : long_path) {
-        final_moves.push_back(move);
-        move.apply(board);
-      }
-      i++;
-
-      if (check_deadline())
-        break;
+      apply_round_moves(ctx, long_path, board, final_moves);
     }
+    // Once for the batch, because offering validates the whole move list.
+    publish_progress(ctx, final_moves);
+    if (ctx.trace)
+      ctx.trace->end_round(deadline_hit);
+    ctx.stage_budget.add_round("long_path", ctx.get_time() - round_start, gain);
+    i++;
+
+    if (ctx.check_deadline())
+      break;
+  }
 
-    cerr << "# longest_path_stats = " << longest_path_stats << endl;
+  if (config.index == 0 && log_enabled(LOG_STATS)) {
+    LOG_STAT("longest_path_stats", ctx.longest_path_stats);
+    #ifdef LP_TELEMETRY
+    ctx.lp_telemetry.print(LogMessage().stream());
+    LOG_STAT("pick_long_paths_stats", ctx.pick_long_paths_stats);
+    #endif
 
-    cerr << path_scores << endl;
+    ctx.stage_budget.print(LogMessage().stream());
+    ctx.cost_model.print(LogMessage().stream());
+    LOG_STAT("long_path_rounds", i);
+    LOG_STAT("start_cut_ratios", ctx.start_cut_ratios);
+    LOG(LOG_INFO) << path_scores;
     if (path_scores.size() >= 2) {
-      cerr << "# score_ratio = " << 1.0 * path_scores[1] / path_scores[0] << endl;
+      LOG_STAT("score_ratio", 1.0 * path_scores[1] / path_scores[0]);
+    }
+  }
+
+  //cerr << "# long_path_ratio = " << 1.0 * long_path2.size() / long_path.size() << endl;
+
+  //cerr << show_edges(board, 0, preferred_parity) << endl;
+
+  #ifdef LP_CACHE
+  if (ctx.shared_lp_cache)
+    ctx.shared_lp_cache->merge(ctx.lp_cache);
+  #endif
+  return final_moves;
+}
+
+
+// Up to this many variants, because each of them keeps its own caches.
+const int MAX_PORTFOLIO_SIZE = 4;
+
+int default_portfolio_size() {
+  return max(1, min<int>(MAX_PORTFOLIO_SIZE, thread::hardware_concurrency()));
+}
+
+
+// Variant 0 is the plain single threaded pipeline, the others vary the knobs
+// that are single guesses in it.
+PipelineConfig portfolio_config(
+    const Params &params, int index, int preferred_parity) {
+  PipelineConfig config;
+  config.index = index;
+  config.seed = 42 + index;
+  config.preferred_parity = index % 2 == 0 ? preferred_parity : 1 - preferred_parity;
+  config.tile_size =
+      index / 2 % 2 == 0 ? params.tile_size : max(4, params.tile_size - 2);
+  return config;
+}
+
+
+// Runs variants as tasks of ctx.pool until the current deadline and returns
+// the highest scoring move list. Their parallel loops share the pool's
+// threads too, so there are never more threads busy than the pool has. A
+// variant that has to wait for a thread would only start at the deadline, so
+// there are at most as many as threads. Variant 0 gets the given context,
+// each of the others a fresh one.
+vector<Move> run_portfolio(
+    SolverContext &ctx, const Board &board, int preferred_parity, int size) {
+  size = min(size, ctx.pool->size());
+  double deadline = ctx.deadlines.back();
+  vector<vector<Move>> results(size);
+  ctx.pool->parallel_for(size, [&](int k, int slot) {
+    if (k == 0) {
+      results[0] = run_pipeline(ctx, board, portfolio_config(ctx.params, 0, preferred_parity));
+      return;
+    }
+    SolverContext worker_ctx;
+    worker_ctx.push_deadline(deadline);
+    worker_ctx.limits = ctx.limits;
+    worker_ctx.params = ctx.params;
+    worker_ctx.pool = ctx.pool;
+    worker_ctx.cancelled = ctx.cancelled;
+    worker_ctx.best_moves = ctx.best_moves;
+    worker_ctx.shared_lp_cache = ctx.shared_lp_cache;
+    results[k] = run_pipeline(
+        worker_ctx, board, portfolio_config(ctx.params, k, preferred_parity));
+  });
+
+  vector<long long> scores;
+  int best = 0;
+  for (int k = 0; k < size; k++) {
+    scores.push_back(moves_score(board, results[k]));
+    if (scores[k] > scores[best])
+      best = k;
+  }
+  LOG_STAT("portfolio_scores", scores);
+  LOG_STAT("portfolio_winner", best);
+  return results[best];
+}
+
+
+Board parse_board(const vector<int> &peg_values, const vector<string> &board_) {
+  int n = board_.size();
+  Board board(n * n);
+  for (int i = 0; i < n; i++) {
+    assert(board_[i].size() == n);
+    for (int j = 0; j < n; j++) {
+      char c = board_[i][j];
+      if (c != '.') {
+        int value = peg_values.at(c - '0');
+        assert(value != EMPTY && value <= MAX_PEG_VALUE);
+        board[i * n + j] = value;
+      }
+    }
+  }
+  return board;
+}
+
+
+int choose_preferred_parity(const Board &board) {
+  int n = board_size(board);
+  int even_pegs = 0;
+  int odd_pegs = 0;
+  int even_value = 0;
+  int odd_value = 0;
+  for (int pos = 0; pos < n*n; pos++)
+    if (board[pos] != EMPTY) {
+      if ((pos / n + pos % n) % 2 == 0) {
+        even_pegs++;
+        even_value += board[pos];
+      } else {
+        odd_pegs++;
+        odd_value += board[pos];
+      }
     }
 
-    //cerr << "# long_path_ratio = " << 1.0 * long_path2.size() / long_path.size() << endl;
+  LOG(LOG_INFO) << "even value: " << even_pegs*even_value;
+  LOG(LOG_INFO) << "odd value: " << odd_pegs*odd_value;
+
+  // TODO: I suspect it actually reduces score by 5%. Investigate.
+  int preferred_parity = 0;
+  if (n % 2 == 0 and odd_pegs*odd_value > even_pegs*even_value)
+    preferred_parity = 1;
+  return preferred_parity;
+}
+
+
+class PegJumping {
+public:
+  int n;
+  int portfolio_size = default_portfolio_size();
+  int pool_size = max(1u, thread::hardware_concurrency());
+  SolveLimits limits = limits_for_budget(FULL_BUDGET);
+  Params params;
+  // Set by processes that solve many boards, to share them between solves.
+  // Without a pool, every solve starts its own of pool_size threads.
+  TaskPool *pool = nullptr;
+  SharedPathCache *lp_cache = nullptr;
+  #ifdef LP_TELEMETRY
+  ostream *lp_telemetry_dump = nullptr;
+  #endif
+  // If set, gets the SolveTrace of the solve (of portfolio variant 0).
+  ostream *trace_out = nullptr;
+
+  vector<string> getMoves(vector<int> peg_values, vector<string> board_) {
+    SolverContext ctx;
+    Board board = parse_board(peg_values, board_);
+    auto moves = solve(ctx, board);
+    return moves_to_strings(n, moves);
+  }
+
+  // Whole solve of a fresh board within limits.time_limit, or until
+  // ctx.cancelled.
+  vector<Move> solve(SolverContext &ctx, const Board &board) {
+    #ifdef LP_TELEMETRY
+    ctx.lp_telemetry.dump = lp_telemetry_dump;
+    #endif
+
+    auto start_time = ctx.get_time();
+    TaskPool own_pool(pool ? 1 : pool_size);
+    ctx.pool = pool ? pool : &own_pool;
+    ctx.shared_lp_cache = lp_cache;
+    ctx.limits = limits;
+    ctx.params = params;
+    ctx.set_deadline_from_now(limits.time_limit);
+    SolveTrace trace;
+    if (trace_out)
+      ctx.trace = &trace;
+    if (log_enabled(LOG_STATS))
+      ctx.limits.print(LogMessage().stream());
+
+    //benchmark_timers(cerr);
+
+    vector<Move> final_moves;
+    { TimeIt time_it(ctx, "total");
+
+    n = board_size(board);
+    LOG_STAT("n", n);
+    LOG_STAT("density",
+             1.0 * (board.size() - count(board.begin(), board.end(), EMPTY)) /
+             board.size());
+
+    LOG(LOG_DEBUG) << board_to_string(board);
+
+    int preferred_parity = choose_preferred_parity(board);
+    LOG_STAT("preferred_parity", preferred_parity);
 
-    //cerr << show_edges(board, 0, preferred_parity) << endl;
+    if (portfolio_size <= 1)
+      final_moves = run_pipeline(ctx, board, portfolio_config(ctx.params, 0, preferred_parity));
+    else
+      final_moves = run_portfolio(ctx, board, preferred_parity, portfolio_size);
 
     }  // TimeIt
-    print_timers(cerr);
+    if (log_enabled(LOG_STATS))
+      ctx.print_timers(LogMessage().stream());
 
 
     #ifdef LP_CACHE
-    cerr << "# lp_cache_size = " << cache.size() << endl;
+    LOG_STAT("lp_cache_size", ctx.lp_cache.size());
+    if (lp_cache) {
+      LOG_STAT("shared_lp_cache_hits", ctx.shared_lp_cache_hits);
+      LOG_STAT("shared_lp_cache_size", lp_cache->size());
+    }
     #endif
 
-    if (deadlines.size() != 1) cerr << "Deadlines: " << deadlines << endl;
-    assert(deadlines.size() == 1);
-    cerr << "# total_time_for_realz = " << (get_time() - start_time) << endl;
-    cerr << "# get_time_counter = " << get_time_counter << endl;
+    if (ctx.deadlines.size() != 1) cerr << "Deadlines: " << ctx.deadlines << endl;
+    assert(ctx.deadlines.size() == 1);
+    ctx.pop_deadline();
+    if (log_enabled(LOG_STATS))
+      ctx.print_overshoots(LogMessage().stream());
+    LOG_STAT("total_time_for_realz", ctx.get_time() - start_time);
+    LOG_STAT("get_time_counter", ctx.get_time_counter);
+    if (ctx.best_moves)
+      LOG_STAT("best_so_far_updates", ctx.best_moves->num_improvements());
+    LOG_STAT("pool_size", ctx.pool->size());
+    ctx.pool = nullptr;
+    if (trace_out) {
+      trace.write(*trace_out);
+      trace_out->flush();
+      ctx.trace = nullptr;
+    }
 
     #ifndef SUBMISSION
     // Just in case, because there were some mysterious problems.
+    // Smaller budgets can't afford it.
     cerr.flush();
-    usleep(200000);
+    if (limits.time_limit >= FULL_BUDGET)
+      usleep(200000);
     #endif
 
-    return moves_to_strings(n, final_moves);
+    return final_moves;
   }
 };
+
+
+// Anytime interface: the solve runs on a background thread, and the best
+// validated moves found so far can be taken at any moment. The thread only
+// shares State with this object, so it is safe to give up on it.
+class AnytimeSolve {
+public:
+  AnytimeSolve(PegJumping solver, const Board &board)
+      : start_time(get_time()) {
+    state = make_shared<State>(board);
+    auto state = this->state;
+    thread([state, solver, board]() mutable {
+      SolverContext ctx;
+      ctx.cancelled = &state->cancelled;
+      ctx.best_moves = &state->best;
+      state->best.offer(solver.solve(ctx, board));
+      lock_guard<mutex> lock(state->m);
+      state->done = true;
+      state->done_cv.notify_all();
+    }).detach();
+  }
+
+  ~AnytimeSolve() {
+    cancel();
+  }
+
+  void cancel() {
+    state->cancelled = true;
+  }
+
+  bool finished() const {
+    lock_guard<mutex> lock(state->m);
+    return state->done;
+  }
+
+  vector<Move> best_so_far() const {
+    return state->best.get();
+  }
+
+  // Waits for the solve to finish, but no longer than latency_cap seconds
+  // since the start. Past that, cancels it and returns the best so far right
+  // away instead of waiting for the solver to notice.
+  vector<Move> wait(double latency_cap) {
+    {
+      unique_lock<mutex> lock(state->m);
+      auto timeout = chrono::duration<double>(
+          max(0.0, start_time + latency_cap - get_time()));
+      if (!state->done_cv.wait_for(lock, timeout, [this]() { return state->done; })) {
+        LOG_STAT("latency_cap_hit", 1);
+        cancel();
+      }
+    }
+    return best_so_far();
+  }
+
+private:
+  struct State {
+    atomic<bool> cancelled{false};
+    BestMoves best;
+    mutex m;
+    condition_variable done_cv;
+    bool done = false;
+
+    explicit State(const Board &board) : best(board) {}
+  };
+
+  double start_time;
+  shared_ptr<State> state;
+};
@@ -41,6 +41,7 @@ public:
   Board board;
 
   vector<int> moves;
+  vector<Cell> consumed;  // by moves
   vector<Move> best_moves;
 
   int best_score;
@@ -63,10 +64,17 @@ public:
     return result - moves.size();
   }
 
+  // Runs the whole search, up to iteration_limit nodes.
   void rec() {
-    if (cnt > iteration_limit) {
-      return;
-    }
+    SearchEngine<SimpleOptimizer> engine(*this);
+    if (!engine.run(iteration_limit + 1LL - cnt))
+      engine.abandon();
+  }
+
+  // SearchEngine interface. Steps are indices into allowed_moves.
+  typedef int Step;
+
+  bool visit() {
     cnt++;
 
     int score = get_score();
@@ -77,9 +85,10 @@ public:
       for (int i : moves) best_moves.push_back(allowed_moves[i]);
     }
 
-    if (moves.size() >= max_depth)
-      return;
+    return moves.size() < max_depth;
+  }
 
+  void expand(vector<int> &steps) {
     for (int i = 0; i < allowed_moves.size(); i++) {
       int start = allowed_moves[i].start;
       int delta = allowed_moves[i].delta;
@@ -94,37 +103,37 @@ public:
           moves_commute(allowed_moves[moves.back()], allowed_moves[i]))
         continue;
 
-      Cell consumed = board[start + delta];
-      board[start + delta] = EMPTY;
-      board[start + 2*delta] = board[start];
-      board[start] = EMPTY;
+      steps.push_back(i);
+    }
+  }
 
-      moves.push_back(i);
-      rec();
-      moves.pop_back();
+  void apply(int i) {
+    allowed_moves[i].apply(board, consumed);
+    moves.push_back(i);
+  }
 
-      board[start] = board[start + 2*delta];
-      board[start + 2*delta] = EMPTY;
-      board[start + delta] = consumed;
-    }
+  void undo(int i) {
+    moves.pop_back();
+    allowed_moves[i].undo(board, consumed);
   }
 };
 
 
 class BlobPreprocessor {
 public:
+  SolverContext &ctx;
   Board board;
   Board board_mask;
   int n;
   int preferred_parity;
   vector<tuple<int, int, int>> goals;
 
-  BlobPreprocessor(const Board &board, int preferred_parity)
-      : board(board), preferred_parity(preferred_parity) {
+  BlobPreprocessor(SolverContext &ctx, const Board &board, int preferred_parity)
+      : ctx(ctx), board(board), preferred_parity(preferred_parity) {
     n = board_size(board);
     board_mask = Board(n*n);
 
-    vector<pair<int, int>> long_runs = find_long_runs(board, 5);
+    vector<pair<int, int>> long_runs = find_long_runs(board, ctx.params.blob_min_run);
 
     // (left_goal, right_goal, weight)
     for (const auto &run : long_runs) {
@@ -181,6 +190,10 @@ public:
   }
 
   int goal_deficit() const {
+    return goal_deficit(board);
+  }
+
+  int goal_deficit(const Board &board) const {
     int result = 0;
     for (const auto &goal : goals) {
       if (board[get<0>(goal)] != EMPTY and board[get<1>(goal)] != EMPTY)
@@ -189,7 +202,9 @@ public:
     return result;
   }
 
-  vector<Move> optimize_block(int i1, int j1, int i2, int j2) {
+  // Adds the search nodes it took to nodes.
+  vector<Move> optimize_block(
+      const Board &board, int i1, int j1, int i2, int j2, int &nodes) const {
     vector<Move> allowed_moves;
     for (const auto &move : moves_in_a_box(n, i1, j1, i2, j2)) {
       if (board_mask[move.start] != 9 &&
@@ -225,29 +240,31 @@ public:
 
     SimpleOptimizer so(
         board,
-        reward.size() * 2 /* max_depth */, 10000 /* max_iterations */);
+        reward.size() * ctx.params.block_depth_factor /* max_depth */, ctx.limits.block_iterations);
     so.reward = reward;
     so.allowed_moves = allowed_moves;
 
     so.rec();
+    nodes += so.cnt;
 
     assert(so.board == board);
     //cerr << so.best_moves << endl;
     return so.best_moves;
   }
 
-  int try_optimize(int w, int h, vector<Move> &result) {
-    auto backup = board;
+  // Works on its own copy of the board and random state, so that tries can
+  // run in parallel.
+  int try_optimize(
+      Board &board, int w, int h, unsigned int rand_state,
+      vector<Move> &result, int &nodes) const {
     for (int base = 0; base < 20; base++) {
       bool improvement = false;
-      for (int i = rand() % h; i + h <= n; i += h) {
-        for (int j = rand() % w; j + w <= n; j += w) {
-          auto moves = optimize_block(i, j, i + h, j + w);
-          for (const auto &move : moves) {
-            improvement = true;
-            move.apply(board);
-            result.push_back(move);
-          }
+      for (int i = rand_r(&rand_state) % h; i + h <= n; i += h) {
+        for (int j = rand_r(&rand_state) % w; j + w <= n; j += w) {
+          auto moves = optimize_block(board, i, j, i + h, j + w, nodes);
+          improvement = improvement || !moves.empty();
+          apply_all(board, moves);
+          result.insert(result.end(), moves.begin(), moves.end());
         }
       }
       if (!improvement) {
@@ -255,36 +272,51 @@ public:
         break;
       }
     }
-    int gd = goal_deficit();
-    board = backup;
-
-    return gd;
+    return goal_deficit(board);
   }
 
   vector<Move> optimize() {
-    cerr << "# goal_deficit_before = " << goal_deficit() << endl;
+    LOG_STAT("goal_deficit_before", goal_deficit());
 
     vector<Move> best_moves;
     int best_score = 1000000;
 
-    for (int i = 0; i < 20; i++) {
-      vector<Move> moves;
-      int score = try_optimize(4 + rand() % 5, 4 + rand() % 5, moves);
-      if (score < best_score) {
-        cerr << score << " at " << i << endl;
-        best_moves = moves;
-        best_score = score;
-      }
+    // (w, h, seed) of every try, drawn up front so that the outcome doesn't
+    // depend on the order the tries run in.
+    const Params &params = ctx.params;
+    int num_tries = ctx.limits.blob_tries;
+    vector<tuple<int, int, unsigned int>> tries;
+    for (int i = 0; i < num_tries; i++) {
+      int w = params.blob_min_block + ctx.rand() % params.blob_block_range;
+      int h = params.blob_min_block + ctx.rand() % params.blob_block_range;
+      tries.emplace_back(w, h, ctx.rand());
     }
 
-    for (const auto &move : best_moves) {
-      //improvement = true;
-      move.apply(board);
-      //result.push_back(move);
+    vector<vector<Move>> moves(num_tries);
+    vector<int> scores(num_tries, best_score);
+    vector<int> nodes(num_tries);
+    vector<Board> scratch(ctx.pool_size());
+    ctx.parallel_for(num_tries, [&](int i, int slot) {
+      scratch[slot] = board;
+      scores[i] = try_optimize(
+          scratch[slot], get<0>(tries[i]), get<1>(tries[i]), get<2>(tries[i]),
+          moves[i], nodes[i]);
+    });
+    for (int k : nodes)
+      ctx.add_work(BLOCK_NODE, k);
+
+    for (int i = 0; i < num_tries; i++) {
+      if (scores[i] < best_score) {
+        LOG(LOG_INFO) << scores[i] << " at " << i;
+        best_moves = moves[i];
+        best_score = scores[i];
+      }
     }
 
-    cerr << "# goal_deficit_after = " << goal_deficit() << endl;
-    cerr << best_moves.size() << endl;
+    apply_all(board, best_moves);
+
+    LOG_STAT("goal_deficit_after", goal_deficit());
+    LOG(LOG_INFO) << best_moves.size();
     //cerr << board_to_string(board) << endl;
     return best_moves;
   }
@@ -331,22 +363,18 @@ vector<Move> sparsify_blobs(Board board, int preferred_parity) {
 }
 
 
-vector<Move> full_sparsify(Board board, int preferred_parity) {
+vector<Move> full_sparsify(SolverContext &ctx, Board board, int preferred_parity) {
   vector<Move> result;
 
-  BlobPreprocessor bp(board, 1 - preferred_parity);
+  BlobPreprocessor bp(ctx, board, 1 - preferred_parity);
   // cerr << "# goal_deficit_before = " << bp.goal_deficit() << endl;
   // bp.optimize_block(0, 0, 10, 10);
 
-  for (auto move : bp.optimize()) {
-    result.push_back(move);
-    move.apply(board);
-  }
+  result = bp.optimize();
+  apply_all(board, result);
 
-  for (auto move : sparsify_blobs(board, 1 - preferred_parity)) {
-    result.push_back(move);
-    move.apply(board);
-  }
+  vector<Move> blob_moves = sparsify_blobs(board, 1 - preferred_parity);
+  result.insert(result.end(), blob_moves.begin(), blob_moves.end());
   return result;
 }
 
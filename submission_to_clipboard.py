@@ -8,7 +8,8 @@ text = open('sol.cc').read()
 def replacer(m):
   return open(m.group(1)).read()
 
-for _ in range(3):
+# Headers include headers, so repeat until all are inlined.
+while re.search(r'#include "(.+\.h)"', text):
   text = re.sub(r'#include "(.+\.h)"', replacer, text)
 
 text = '#define SUBMISSION\n\n' + text
@@ -0,0 +1,86 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#ifdef LP_TELEMETRY
+// One longest trail query within a 2-edge-connected block.
+struct BlockRecord {
+  int edges;
+  int odd;
+  int upper_bound;
+  int length;
+  int rounds;
+  double time;  // wall seconds
+  const char *source;  // "euler", "hit" or "miss"
+};
+
+
+// Aggregates BlockRecords into histograms, and optionally dumps each of them
+// as a JSON line.
+class LongestPathTelemetry {
+public:
+  ostream *dump = nullptr;
+
+  int num_euler = 0;
+  int num_hits = 0;
+  int num_misses = 0;
+  double total_time = 0.0;
+
+  map<int, int> gap_hist;  // capped at MAX_GAP
+  map<int, double> time_by_gap;
+  map<int, int> rounds_hist;
+  map<int, int> edges_hist;  // by power of two
+  map<int, double> time_by_edges;
+
+  static const int MAX_GAP = 20;
+
+  void add(const BlockRecord &r) {
+    if (dump != nullptr) {
+      *dump << "{\"edges\": " << r.edges
+            << ", \"odd\": " << r.odd
+            << ", \"upper_bound\": " << r.upper_bound
+            << ", \"length\": " << r.length
+            << ", \"rounds\": " << r.rounds
+            << ", \"time\": " << r.time
+            << ", \"source\": \"" << r.source << "\"}" << endl;
+    }
+
+    total_time += r.time;
+    if (string(r.source) == "euler") {
+      num_euler++;
+      return;
+    }
+    if (string(r.source) == "hit")
+      num_hits++;
+    else
+      num_misses++;
+
+    int gap = r.upper_bound - r.length;
+    if (gap > MAX_GAP)
+      gap = MAX_GAP;
+    gap_hist[gap]++;
+    time_by_gap[gap] += r.time;
+    rounds_hist[r.rounds]++;
+
+    int bucket = 1;
+    while (bucket * 2 <= r.edges)
+      bucket *= 2;
+    edges_hist[bucket]++;
+    time_by_edges[bucket] += r.time;
+  }
+
+  void print(ostream &out) const {
+    out << "# lp_euler_blocks = " << num_euler << endl;
+    out << "# lp_cache_hits = " << num_hits << endl;
+    out << "# lp_cache_misses = " << num_misses << endl;
+    out << "# lp_block_time = " << total_time << endl;
+    out << "# lp_gap_hist = " << gap_hist << endl;
+    out << "# lp_time_by_gap = " << time_by_gap << endl;
+    out << "# lp_rounds_hist = " << rounds_hist << endl;
+    out << "# lp_edges_hist = " << edges_hist << endl;
+    out << "# lp_time_by_edges = " << time_by_edges << endl;
+  }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+
+// Binary record of one solve pipeline (variant 0 of the portfolio), for
+// replay.cc: the input board with everything that determines the stages
+// (seed, parity, tile size, limits and params), then for every stage round
+// a checkpoint (time and random state), the moves it applied, the scores of
+// the long path candidates it picked from, and whether its deadline cut it
+// short. Moves are PackedMove, so a trace is about 5 bytes per move.
+//
+// Built in memory and written at the end of the solve, so a solve abandoned
+// at the latency cap leaves no trace.
+
+enum TraceStage {
+  TRACE_SPARSIFY,
+  TRACE_PATCH,
+  TRACE_LONG_PATH,
+  NUM_TRACE_STAGES
+};
+
+const char *const TRACE_STAGE_NAMES[NUM_TRACE_STAGES] = {
+  "sparsify", "patch", "long_path",
+};
+
+const char TRACE_MAGIC[4] = {'P', 'J', 'T', '2'};
+
+
+// What a trace says about one stage round.
+struct TraceRound {
+  TraceStage stage;
+  int index;  // within the stage
+  double start_time;  // seconds since the start of the pipeline
+  double end_time;
+  unsigned int rand_state;
+  int moves_before;  // moves applied by earlier rounds
+  vector<PackedMove> moves;
+  vector<int> candidate_scores;
+  bool deadline_hit;
+};
+
+
+class SolveTrace {
+public:
+  Board board;
+  unsigned int seed = 0;
+  int preferred_parity = 0;
+  int tile_size = 0;
+  SolveLimits limits;
+  Params params;
+  vector<TraceRound> rounds;
+
+  SolveTrace() {}
+
+  SolveTrace(const Board &board, unsigned int seed, int preferred_parity,
+             int tile_size, const SolveLimits &limits, const Params &params)
+      : board(board), seed(seed), preferred_parity(preferred_parity),
+        tile_size(tile_size), limits(limits), params(params),
+        start_time(get_time()) {}
+
+  void begin_round(TraceStage stage, unsigned int rand_state) {
+    TraceRound round;
+    round.stage = stage;
+    round.index = 0;
+    for (const auto &r : rounds)
+      round.index += r.stage == stage;
+    round.start_time = round.end_time = get_time() - start_time;
+    round.rand_state = rand_state;
+    round.moves_before = num_moves;
+    round.deadline_hit = false;
+    rounds.push_back(round);
+  }
+
+  void move(const Move &move) {
+    assert(!rounds.empty());
+    rounds.back().moves.push_back(pack_move(board_size(board), move));
+    num_moves++;
+  }
+
+  void candidates(const vector<int> &scores) {
+    assert(!rounds.empty());
+    rounds.back().candidate_scores = scores;
+  }
+
+  void end_round(bool deadline_hit) {
+    assert(!rounds.empty());
+    rounds.back().end_time = get_time() - start_time;
+    rounds.back().deadline_hit = deadline_hit;
+  }
+
+  // All moves of the rounds before round k.
+  vector<Move> moves_before(int k) const {
+    int n = board_size(board);
+    vector<Move> result;
+    for (int r = 0; r < k; r++)
+      for (PackedMove m : rounds[r].moves)
+        result.push_back(unpack_move(n, m));
+    return result;
+  }
+
+  void write(ostream &out) {
+    out.write(TRACE_MAGIC, 4);
+    put<uint32_t>(out, board.size());
+    for (Cell c : board)
+      put<int32_t>(out, c);
+    put<uint32_t>(out, seed);
+    put<int32_t>(out, preferred_parity);
+    put<int32_t>(out, tile_size);
+    for (double *f : limit_doubles(limits))
+      put<double>(out, *f);
+    for (int *f : limit_ints(limits))
+      put<int32_t>(out, *f);
+    auto names = params.names();
+    put<uint32_t>(out, names.size());
+    for (const auto &name : names) {
+      put<uint32_t>(out, name.size());
+      out.write(name.data(), name.size());
+      put<double>(out, params.get(name));
+    }
+
+    put<uint32_t>(out, rounds.size());
+    for (const auto &r : rounds) {
+      put<uint8_t>(out, r.stage);
+      put<double>(out, r.start_time);
+      put<double>(out, r.end_time);
+      put<uint32_t>(out, r.rand_state);
+      put<uint8_t>(out, r.deadline_hit);
+      put<uint32_t>(out, r.moves.size());
+      out.write((const char*)r.moves.data(), r.moves.size() * sizeof(PackedMove));
+      put<uint32_t>(out, r.candidate_scores.size());
+      for (int s : r.candidate_scores)
+        put<int32_t>(out, s);
+    }
+  }
+
+  // Returns false on a truncated or foreign file.
+  bool read(istream &in) {
+    char magic[4];
+    if (!in.read(magic, 4) || !equal(magic, magic + 4, TRACE_MAGIC))
+      return false;
+    board.resize(get<uint32_t>(in));
+    for (Cell &c : board)
+      c = get<int32_t>(in);
+    seed = get<uint32_t>(in);
+    preferred_parity = get<int32_t>(in);
+    tile_size = get<int32_t>(in);
+    for (double *f : limit_doubles(limits))
+      *f = get<double>(in);
+    for (int *f : limit_ints(limits))
+      *f = get<int32_t>(in);
+    int num_params = get<uint32_t>(in);
+    for (int k = 0; k < num_params && in; k++) {
+      string name(get<uint32_t>(in), ' ');
+      in.read(&name[0], name.size());
+      params.set(name, get<double>(in));
+    }
+
+    rounds.resize(in ? get<uint32_t>(in) : 0);
+    num_moves = 0;
+    vector<int> stage_rounds(NUM_TRACE_STAGES);
+    for (auto &r : rounds) {
+      r.stage = TraceStage(get<uint8_t>(in) % NUM_TRACE_STAGES);
+      r.index = stage_rounds[r.stage]++;
+      r.start_time = get<double>(in);
+      r.end_time = get<double>(in);
+      r.rand_state = get<uint32_t>(in);
+      r.deadline_hit = get<uint8_t>(in);
+      r.moves_before = num_moves;
+      r.moves.resize(in ? get<uint32_t>(in) : 0);
+      in.read((char*)r.moves.data(), r.moves.size() * sizeof(PackedMove));
+      num_moves += r.moves.size();
+      r.candidate_scores.resize(in ? get<uint32_t>(in) : 0);
+      for (int &s : r.candidate_scores)
+        s = get<int32_t>(in);
+      if (!in)
+        return false;
+    }
+    return bool(in);
+  }
+
+private:
+  double start_time = 0;
+  int num_moves = 0;
+
+  template<typename T>
+  static void put(ostream &out, T x) {
+    out.write((const char*)&x, sizeof x);
+  }
+
+  template<typename T>
+  static T get(istream &in) {
+    T x = T();
+    in.read((char*)&x, sizeof x);
+    return x;
+  }
+
+  static vector<double*> limit_doubles(SolveLimits &l) {
+    return {&l.time_limit};
+  }
+
+  static vector<int*> limit_ints(SolveLimits &l) {
+    return {&l.min_sparsify_rounds, &l.max_sparsify_rounds,
+            &l.min_patch_rounds, &l.max_patch_rounds,
+            &l.patch_iterations, &l.block_iterations, &l.blob_tries};
+  }
+};
+
+
+#endif
@@ -0,0 +1,194 @@
+// Offline search over Params. Solves a corpus of boards (files in the format
+// main reads, e.g. inputs/ from grab_inputs.sh) on all cores at a fixed
+// budget, mutates one parameter at a time and keeps the change when the
+// corpus gets better. The best parameters so far are written after every
+// improvement, in the format main loads at startup (params.txt).
+//
+// g++ --std=c++11 -O2 -pthread tuner.cc -o tuner
+// ./tuner -budget fast -iterations 100 -out params.txt inputs/*.txt
+
+#define SUBMISSION
+
+#include <iostream>
+#include <fstream>
+
+#include "pretty_printing.h"
+
+using namespace std;
+
+#include "sol.cc"
+#include "corpus.h"
+
+
+struct ParamRange {
+  string name;
+  double lo;
+  double hi;
+  double step;  // for ints; doubles are scaled by up to this factor
+};
+
+const vector<ParamRange> PARAM_RANGES = {
+  {"blob_min_run", 3, 8, 1},
+  {"blob_min_block", 2, 8, 1},
+  {"blob_block_range", 1, 8, 1},
+  {"block_depth_factor", 1, 4, 1},
+  {"inner_endpoints", 0, 4, 1},
+  {"tile_size", 4, 12, 2},
+  {"patch_share", 0.05, 0.6, 1.5},
+  {"long_path_share", 0.3, 1.0, 1.3},
+  {"min_batch_score_ratio", 0.2, 1.0, 1.3},
+};
+
+
+// Scores of all boards, solved in parallel, one solve per core at a time.
+vector<long long> solve_corpus(
+    const vector<CorpusBoard> &corpus, const Params &params,
+    const SolveLimits &limits, int num_threads) {
+  vector<long long> scores(corpus.size());
+  atomic<int> next(0);
+  auto worker = [&]() {
+    while (true) {
+      int i = next++;
+      if (i >= corpus.size())
+        break;
+      PegJumping solver;
+      solver.portfolio_size = 1;
+      solver.pool_size = 1;
+      solver.limits = limits;
+      solver.params = params;
+      Board board = parse_board(corpus[i].peg_values, corpus[i].rows);
+      SolverContext ctx;
+      scores[i] = moves_score(board, solver.solve(ctx, board));
+    }
+  };
+  vector<thread> threads;
+  for (int k = 0; k < num_threads; k++)
+    threads.emplace_back(worker);
+  for (auto &t : threads)
+    t.join();
+  return scores;
+}
+
+
+// Mean score relative to the baseline, as in the contest's relative scoring.
+double relative_score(
+    const vector<long long> &scores, const vector<long long> &baseline) {
+  double sum = 0;
+  for (int i = 0; i < scores.size(); i++)
+    sum += 1.0 * scores[i] / max(1LL, baseline[i]);
+  return sum / scores.size();
+}
+
+
+Params mutate(Params params, mt19937 &rng) {
+  while (true) {
+    const auto &range = PARAM_RANGES[rng() % PARAM_RANGES.size()];
+    double old_value = params.get(range.name);
+    double value;
+    if (params.is_int(range.name)) {
+      value = old_value + (rng() % 2 == 0 ? -range.step : range.step);
+    } else {
+      double factor = exp(uniform_real_distribution<double>(
+          -log(range.step), log(range.step))(rng));
+      value = old_value * factor;
+    }
+    value = max(range.lo, min(range.hi, value));
+    if (value != old_value) {
+      params.set(range.name, value);
+      return params;
+    }
+  }
+}
+
+
+void write_params(const string &filename, Params params, double score) {
+  ofstream out(filename);
+  out << "# relative_score = " << score << endl;
+  params.write(out);
+}
+
+
+int main(int argc, char **argv) {
+  double budget = 1.0;
+  int iterations = 50;
+  int num_threads = max(1u, thread::hardware_concurrency());
+  double min_gain = 0.002;
+  unsigned int seed = 1;
+  string out_file = "params.txt";
+  string start_file;
+  vector<string> board_files;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "-budget" && has_value) {
+      if (!parse_budget(argv[++i], budget)) {
+        cerr << "Bad budget " << argv[i] << endl;
+        return 1;
+      }
+    } else if (arg == "-iterations" && has_value) {
+      iterations = atoi(argv[++i]);
+    } else if (arg == "-threads" && has_value) {
+      num_threads = atoi(argv[++i]);
+    } else if (arg == "-min_gain" && has_value) {
+      min_gain = atof(argv[++i]);
+    } else if (arg == "-seed" && has_value) {
+      seed = atoi(argv[++i]);
+    } else if (arg == "-out" && has_value) {
+      out_file = argv[++i];
+    } else if (arg == "-start" && has_value) {
+      start_file = argv[++i];
+    } else if (!arg.empty() && arg[0] == '-') {
+      cerr << "Unknown option " << arg << endl;
+      return 1;
+    } else {
+      board_files.push_back(arg);
+    }
+  }
+  if (board_files.empty()) {
+    cerr << "usage: tuner [-budget tier_or_seconds] [-iterations k] "
+         << "[-threads k] [-min_gain x] [-seed s] [-start params.txt] "
+         << "[-out params.txt] board_files..." << endl;
+    return 1;
+  }
+
+  vector<CorpusBoard> corpus;
+  for (const auto &f : board_files)
+    corpus.push_back(read_board(f));
+
+  Params best;
+  if (!start_file.empty() && !best.load(start_file))
+    return 1;
+  SolveLimits limits = limits_for_budget(budget);
+
+  // The solver is chatty, and nobody reads it here.
+  log_level = LOG_OFF;
+
+  mt19937 rng(seed);
+  vector<long long> baseline = solve_corpus(corpus, best, limits, num_threads);
+  // Re-solving the baseline tells how noisy the timing makes the scores.
+  double best_score = relative_score(
+      solve_corpus(corpus, best, limits, num_threads), baseline);
+  cout << "# boards = " << corpus.size() << endl;
+  cout << "# budget = " << budget << endl;
+  cout << "# baseline_noise = " << best_score - 1.0 << endl;
+  best_score = 1.0;
+  write_params(out_file, best, best_score);
+
+  for (int it = 0; it < iterations; it++) {
+    Params candidate = mutate(best, rng);
+    double score = relative_score(
+        solve_corpus(corpus, candidate, limits, num_threads), baseline);
+    bool accepted = score > best_score + min_gain;
+    cout << it << " " << score << (accepted ? " accepted" : "") << endl;
+    if (accepted) {
+      best = candidate;
+      best_score = score;
+      write_params(out_file, best, best_score);
+      best.write(cout);
+    }
+  }
+
+  cout << "# best_relative_score = " << best_score << endl;
+  return 0;
+}
@@ -0,0 +1,238 @@
+#ifndef VALIDATOR_H
+#define VALIDATOR_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+// A move in 32 bits: start cell (row * n + column) << 2 | direction.
+typedef uint32_t PackedMove;
+
+enum Direction {
+  DIR_UP,
+  DIR_RIGHT,
+  DIR_DOWN,
+  DIR_LEFT,
+};
+
+
+// Outcome of replaying a move list.
+struct Validation {
+  bool ok = true;
+  long long score = 0;  // of the paths before the first illegal jump
+  int jumps = 0;  // legal ones
+  int paths = 0;
+  std::string error;  // what was wrong, if not ok
+};
+
+
+// Replays move lists by the game rules and scores them, independently of
+// Move::apply and its asserts: a peg jumps over an adjacent peg onto an
+// empty cell within one row or column, and a path of k jumps by one peg
+// scores k times the sum of the jumped pegs. Keeps the board with a border
+// of two walls, so a jump is checked by three loads.
+//
+// Accepts the output text of getMoves, where every line is a path, or
+// lists of Move or PackedMove, where consecutive jumps of one peg form a
+// path (as moves_to_strings prints them).
+class MoveValidator {
+public:
+  // n * n cells, 0 for empty and the peg value otherwise: a Board or a
+  // vector<int>.
+  template<typename Cells>
+  explicit MoveValidator(const Cells &cells)
+      : n(0), w(0) {
+    while (n * n < cells.size())
+      n++;
+    w = n + 2 * BORDER;
+    initial.assign(w * w, WALL);
+    for (int pos = 0; pos < cells.size(); pos++)
+      initial[padded(pos)] = cells[pos];
+  }
+
+  // The number of lines, then "row column directions" per line.
+  Validation replay_text(const std::string &text) {
+    Validation v;
+    start();
+    const char *p = text.c_str();
+    int count;
+    if (!read_int(p, count) || count < 0)
+      return fail(v, "bad line count");
+    for (int line = 0; line < count; line++) {
+      if (!replay_line(p, v))
+        return v;
+    }
+    skip_space(p);
+    if (*p != '\0')
+      return fail(v, "more lines than the count says");
+    return v;
+  }
+
+  // Lines as moves_to_strings makes them.
+  Validation replay_lines(const std::vector<std::string> &lines) {
+    Validation v;
+    start();
+    for (const auto &line : lines) {
+      const char *p = line.c_str();
+      if (!replay_line(p, v))
+        return v;
+      skip_space(p);
+      if (*p != '\0')
+        return fail(v, "junk after line " + std::to_string(v.paths));
+    }
+    return v;
+  }
+
+  Validation replay_packed(const PackedMove *moves, int count) {
+    Validation v;
+    start();
+    for (int k = 0; k < count; k++) {
+      int pos = moves[k] >> 2;
+      if (pos >= n * n)
+        return fail(v, "start off the board at jump " + std::to_string(k));
+      if (!step(padded(pos), moves[k] & 3, v))
+        return v;
+    }
+    finish_path(v);
+    return v;
+  }
+
+  // Anything with start and delta in row * n + column coordinates, like
+  // vector<Move>.
+  template<typename MoveList>
+  Validation replay(const MoveList &moves) {
+    Validation v;
+    start();
+    for (const auto &move : moves) {
+      int dir = move.delta == -n ? DIR_UP :
+                move.delta == 1 ? DIR_RIGHT :
+                move.delta == n ? DIR_DOWN :
+                move.delta == -1 ? DIR_LEFT : -1;
+      if (dir < 0)
+        return fail(v, "bad delta at jump " + std::to_string(v.jumps));
+      if (move.start < 0 || move.start >= n * n)
+        return fail(v, "start off the board at jump " + std::to_string(v.jumps));
+      if (!step(padded(move.start), dir, v))
+        return v;
+    }
+    finish_path(v);
+    return v;
+  }
+
+private:
+  enum {
+    BORDER = 2,
+    WALL = -1,
+  };
+
+  int n;
+  int w;
+  std::vector<int> initial;
+  std::vector<int> cells;
+  int offsets[4];
+  // Current path.
+  int at;
+  int length;
+  long long sum;
+
+  int padded(int pos) const {
+    return (pos / n + BORDER) * w + pos % n + BORDER;
+  }
+
+  void start() {
+    cells = initial;
+    offsets[DIR_UP] = -w;
+    offsets[DIR_RIGHT] = 1;
+    offsets[DIR_DOWN] = w;
+    offsets[DIR_LEFT] = -1;
+    at = -1;
+    length = 0;
+    sum = 0;
+  }
+
+  void finish_path(Validation &v) {
+    if (length > 0) {
+      v.score += length * sum;
+      v.paths++;
+    }
+    length = 0;
+    sum = 0;
+  }
+
+  // Jump from cell from (padded), continuing the current path if the peg
+  // there is the one that made the last jump.
+  bool step(int from, int dir, Validation &v) {
+    if (from != at)
+      finish_path(v);
+    int middle = from + offsets[dir];
+    int target = middle + offsets[dir];
+    if (cells[from] <= 0 || cells[middle] <= 0 || cells[target] != 0) {
+      fail(v, "illegal jump " + std::to_string(v.jumps));
+      return false;
+    }
+    length++;
+    sum += cells[middle];
+    cells[target] = cells[from];
+    cells[from] = 0;
+    cells[middle] = 0;
+    at = target;
+    v.jumps++;
+    return true;
+  }
+
+  // One line "row column directions" as its own path.
+  bool replay_line(const char *&p, Validation &v) {
+    int row, column;
+    if (!read_int(p, row) || !read_int(p, column) ||
+        row < 0 || row >= n || column < 0 || column >= n) {
+      fail(v, "bad start in line " + std::to_string(v.paths));
+      return false;
+    }
+    finish_path(v);
+    at = (row + BORDER) * w + column + BORDER;
+    skip_space(p);
+    const char *first = p;
+    for (; *p && !isspace((unsigned char)*p); p++) {
+      int dir = *p == 'U' ? DIR_UP : *p == 'R' ? DIR_RIGHT :
+                *p == 'D' ? DIR_DOWN : *p == 'L' ? DIR_LEFT : -1;
+      if (dir < 0) {
+        fail(v, "bad direction in line " + std::to_string(v.paths));
+        return false;
+      }
+      if (!step(at, dir, v))
+        return false;
+    }
+    if (p == first) {
+      fail(v, "no jumps in line " + std::to_string(v.paths));
+      return false;
+    }
+    finish_path(v);
+    return true;
+  }
+
+  Validation &fail(Validation &v, const std::string &error) {
+    v.ok = false;
+    v.error = error;
+    return v;
+  }
+
+  static void skip_space(const char *&p) {
+    while (*p && isspace((unsigned char)*p))
+      p++;
+  }
+
+  static bool read_int(const char *&p, int &x) {
+    skip_space(p);
+    if (*p < '0' || *p > '9')
+      return false;
+    x = 0;
+    while (*p >= '0' && *p <= '9')
+      x = x * 10 + (*p++ - '0');
+    return true;
+  }
+};
+
+
+#endif
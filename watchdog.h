@@ -0,0 +1,110 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+// One thread for the whole process that sets deadline flags when their time
+// comes, so that checking a deadline is a single relaxed load.
+class DeadlineWatchdog {
+public:
+  static DeadlineWatchdog &instance() {
+    static DeadlineWatchdog watchdog;
+    return watchdog;
+  }
+
+  // Sets *flag at the deadline (get_time() seconds), or right away if it has
+  // passed. Replaces the previous deadline of the flag. The flag is reset
+  // under the same lock as loop() sets it, so the previous deadline can't
+  // fire after the new one is armed.
+  void arm(atomic<bool> *flag, double deadline) {
+    {
+      lock_guard<mutex> lock(m);
+      if (get_time() >= deadline) {
+        armed.erase(flag);
+        flag->store(true, memory_order_relaxed);
+        return;
+      }
+      flag->store(false, memory_order_relaxed);
+      armed[flag] = deadline;
+    }
+    cv.notify_one();
+  }
+
+  void disarm(atomic<bool> *flag) {
+    lock_guard<mutex> lock(m);
+    armed.erase(flag);
+  }
+
+  // Disarms and leaves *flag at value.
+  void disarm(atomic<bool> *flag, bool value) {
+    lock_guard<mutex> lock(m);
+    armed.erase(flag);
+    flag->store(value, memory_order_relaxed);
+  }
+
+  // Worst delay between a deadline and its flag being set, in seconds.
+  double max_latency() {
+    lock_guard<mutex> lock(m);
+    return latency;
+  }
+
+  ~DeadlineWatchdog() {
+    {
+      lock_guard<mutex> lock(m);
+      stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+  }
+
+private:
+  mutex m;
+  condition_variable cv;
+  map<atomic<bool>*, double> armed;
+  bool stopping = false;
+  double latency = 0.0;
+  thread worker;
+
+  DeadlineWatchdog() : worker([this]() { loop(); }) {}
+
+  static chrono::system_clock::time_point to_time_point(double t) {
+    // Same clock as gettimeofday in get_time().
+    return chrono::system_clock::time_point(
+        chrono::duration_cast<chrono::system_clock::duration>(
+            chrono::duration<double>(t)));
+  }
+
+  void loop() {
+    unique_lock<mutex> lock(m);
+    while (!stopping) {
+      if (armed.empty()) {
+        cv.wait(lock);
+        continue;
+      }
+      double earliest = armed.begin()->second;
+      for (const auto &kv : armed)
+        earliest = min(earliest, kv.second);
+      cv.wait_until(lock, to_time_point(earliest));
+
+      double now = get_time();
+      for (auto p = armed.begin(); p != armed.end(); ) {
+        if (p->second <= now) {
+          p->first->store(true, memory_order_relaxed);
+          latency = max(latency, now - p->second);
+          p = armed.erase(p);
+        } else {
+          ++p;
+        }
+      }
+    }
+  }
+};
+
+
+#endif